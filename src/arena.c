@@ -0,0 +1,103 @@
+// Linear allocator over a reserved range of address space. Pages are committed
+// as the arena grows, and everything is released at once with a reset.
+// Not thread-safe, each thread gets its own arena
+
+arena_t arena_create(u64 reserve_size) {
+    arena_t arena = { 0 };
+    arena.base = VirtualAlloc(NULL, reserve_size, MEM_RESERVE, PAGE_NOACCESS);
+    assert(arena.base);
+    arena.reserved = reserve_size;
+    return arena;
+}
+
+void arena_destroy(arena_t* arena) {
+    if (arena->base) VirtualFree(arena->base, 0, MEM_RELEASE);
+    memset(arena, 0, sizeof(arena_t));
+}
+
+void arena_commit(arena_t* arena, u64 size) {
+    if (size <= arena->committed) return;
+
+    u64 new_committed = (size + ARENA_COMMIT_SIZE - 1) & ~(u64)(ARENA_COMMIT_SIZE - 1);
+    if (new_committed > arena->reserved) new_committed = arena->reserved;
+    if (size > new_committed) {
+        printf("arena out of reserved space: %llu bytes\n", (unsigned long long)size);
+        assert(false);
+    }
+
+    void* result = VirtualAlloc(arena->base + arena->committed, new_committed - arena->committed, MEM_COMMIT, PAGE_READWRITE);
+    assert(result);
+    arena->committed = new_committed;
+}
+
+void* arena_push(arena_t* arena, u64 size) {
+    u64 offset = (arena->used + 15) & ~(u64)15;
+    arena_commit(arena, offset + size);
+    arena->used = offset + size;
+    if (arena->used > arena->high_water) arena->high_water = arena->used;
+    arena->alloc_count++;
+    return arena->base + offset;
+}
+
+void* arena_grow(arena_t* arena, void* data, u64 old_size, u64 new_size) {
+    // The last allocation grows in place, anything else is copied to the top
+    if (data != NULL && (u8*)data + old_size == arena->base + arena->used) {
+        arena_commit(arena, arena->used - old_size + new_size);
+        arena->used += new_size - old_size;
+        if (arena->used > arena->high_water) arena->high_water = arena->used;
+        return data;
+    }
+
+    void* result = arena_push(arena, new_size);
+    if (data != NULL) memcpy(result, data, old_size);
+    return result;
+}
+
+u64 arena_mark(arena_t* arena) {
+    return arena->used;
+}
+
+void arena_pop_to(arena_t* arena, u64 mark) {
+    // Frees everything pushed since the mark
+    assert(mark <= arena->used);
+    arena->used = mark;
+}
+
+void arena_reset(arena_t* arena) {
+    // Committed pages are kept for the next use
+    arena->used = 0;
+}
+
+void arena_decommit_above(arena_t* arena, u64 keep_size) {
+    // Gives back the committed pages past "keep_size" that are no longer in use
+    u64 keep = (arena->used > keep_size) ? arena->used : keep_size;
+    keep = (keep + ARENA_COMMIT_SIZE - 1) & ~(u64)(ARENA_COMMIT_SIZE - 1);
+    if (keep >= arena->committed) return;
+
+    VirtualFree(arena->base + keep, arena->committed - keep, MEM_DECOMMIT);
+    arena->committed = keep;
+}
+
+// One scratch arena for the loading thread (0), and one per parse worker
+static arena_t scratch_arenas[OBJ_PARSE_MAX_THREADS + 1];
+
+arena_t* get_scratch_arena(u32 i) {
+    assert(i <= OBJ_PARSE_MAX_THREADS);
+    if (scratch_arenas[i].base == NULL) {
+        scratch_arenas[i] = arena_create(ARENA_RESERVE_SIZE);
+    }
+    return &scratch_arenas[i];
+}
+
+void reset_scratch_arenas(void) {
+    // One big load shouldn't keep its memory committed for the rest of the run
+    for (u32 i = 0; i <= OBJ_PARSE_MAX_THREADS; i++) {
+        arena_reset(&scratch_arenas[i]);
+        arena_decommit_above(&scratch_arenas[i], ARENA_SCRATCH_KEEP_SIZE);
+    }
+}
+
+void print_arena_stats(char* label, arena_t* arena) {
+    printf("  %s: %u allocations, high water %.2f MB, committed %.2f MB\n", label, arena->alloc_count,
+            (double)arena->high_water / (1024.0 * 1024.0), (double)arena->committed / (1024.0 * 1024.0));
+}
@@ -1,28 +1,74 @@
-char* read_entire_file(char* file_name) { 
-    // taken from: https://stackoverflow.com/a/14002993/4894526
-    
-    // Need to read as binary "rb". If we read it as text (i.e. "r"),
-    // then Windows line endings "\r\n" are converted to "\n" on `fread`
-    // but `ftell` counts them, since they're part of the file.
-    // https://stackoverflow.com/a/23690485/4894526
-    FILE* f = fopen(file_name, "rb");
+filemap_t map_entire_file(char* file_name, bool sequential) {
+    // Returns an empty view (data == NULL) if the file can't be mapped.
+    // "sequential" is a hint that the whole view is about to be read front to back
+    filemap_t map = { 0 };
+    if (vfs_is_mounted()) {
+        // Already mapped and prefetched with the pack
+        packentry_t* p_entry = vfs_find(file_name);
+        if (p_entry == NULL) return map;
+        return vfs_map_entry(p_entry);
+    }
 
-    if (f == NULL) {
+    DWORD flags = FILE_ATTRIBUTE_NORMAL | (sequential ? FILE_FLAG_SEQUENTIAL_SCAN : 0);
+    map.file = CreateFileA(file_name, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, flags, NULL);
+    if (map.file == INVALID_HANDLE_VALUE) {
+        map.file = NULL;
+        return map;
+    }
+
+    LARGE_INTEGER file_size;
+    GetFileSizeEx(map.file, &file_size);
+    map.size = (u64)file_size.QuadPart;
+
+    // Can't map an empty file
+    map.mapping = (map.size > 0) ? CreateFileMappingA(map.file, NULL, PAGE_READONLY, 0, 0, NULL) : NULL;
+    if (map.mapping != NULL) {
+        map.data = MapViewOfFile(map.mapping, FILE_MAP_READ, 0, 0, 0);
+    }
+
+    if (sequential && map.data != NULL) {
+        // Closest thing to madvise(MADV_SEQUENTIAL|MADV_WILLNEED): start paging in right away
+        WIN32_MEMORY_RANGE_ENTRY range = { map.data, map.size };
+        PrefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0);
+    }
+    return map;
+}
+
+filemap_t read_entire_file(char* file_name) { 
+    // Read-only view of the whole file, no copy. Not null-terminated, use "size".
+    // Unlike the map_entire_file, a missing file is an error
+    filemap_t map = map_entire_file(file_name, true);
+    if (map.file == NULL && map.data == NULL) {
         printf("file not found: %s\n", file_name);
         assert(false);
     }
+    return map;
+}
 
-    fseek(f, 0, SEEK_END);
-    i32 file_size = ftell(f);
-    fseek(f, 0, SEEK_SET);
-
-    char* buffer = malloc((file_size + 1) * sizeof(char));
-    fread(buffer, file_size, 1, f);
-    fclose(f);
+bool get_file_info(char* file_name, u64* p_size, u64* p_mtime) {
+    // The pack keeps what the loose file had when it was packed
+    if (vfs_is_mounted()) {
+        packentry_t* p_entry = vfs_find(file_name);
+        if (p_entry == NULL) return false;
+        *p_size = p_entry->size;
+        *p_mtime = p_entry->mtime;
+        return true;
+    }
 
-    buffer[file_size] = 0;
+    WIN32_FILE_ATTRIBUTE_DATA attributes;
+    if (!GetFileAttributesExA(file_name, GetFileExInfoStandard, &attributes)) return false;
+    *p_size = ((u64)attributes.nFileSizeHigh << 32) | attributes.nFileSizeLow;
+    *p_mtime = ((u64)attributes.ftLastWriteTime.dwHighDateTime << 32) | attributes.ftLastWriteTime.dwLowDateTime;
+    return true;
+}
 
-    return buffer;
+void unmap_file(filemap_t* p_map) {
+    // Views into the pack have no mapping of their own
+    if (p_map->owns_data) VirtualFree(p_map->data, 0, MEM_RELEASE);
+    if (p_map->mapping) UnmapViewOfFile(p_map->data);
+    if (p_map->mapping) CloseHandle(p_map->mapping);
+    if (p_map->file) CloseHandle(p_map->file);
+    memset(p_map, 0, sizeof(filemap_t));
 }
 
 void append_prefix(char* str, const char* prefix, u64 max_len, char* result) {
@@ -31,220 +77,1511 @@ void append_prefix(char* str, const char* prefix, u64 max_len, char* result) {
     strcat_s(result + len_prefix, max_len - len_prefix, str);
 }
 
+void* array_reserve(arena_t* arena, void* data, u32 count, u32* capacity, u32 needed, u64 element_size) {
+    // Makes room for "needed" more elements, doubling the capacity when full
+    if (count + needed <= *capacity) return data;
+
+    u32 new_capacity = (*capacity == 0) ? 64 : *capacity;
+    while (new_capacity < count + needed) new_capacity *= 2;
+
+    data = arena_grow(arena, data, *capacity * element_size, new_capacity * element_size);
+    *capacity = new_capacity;
+    return data;
+}
+
+//
+// Hand-written scanners. They work on [c, end) and return the position
+// right after what they've consumed. None of them go past a '\n'
+//
+
+bool parse_is_space(char c) {
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+char* parse_skip_spaces(char* c, char* end) {
+    while (c < end && parse_is_space(*c)) c++;
+    return c;
+}
+
+char* parse_skip_line(char* c, char* end) {
+    while (c < end && *c != '\n') c++;
+    return (c < end) ? c + 1 : end;
+}
+
+bool parse_keyword(char* c, char* end, const char* keyword, u64 keyword_len) {
+    // Matches only when followed by whitespace, so "v" doesn't match "vt"
+    return (u64)(end - c) > keyword_len 
+        && strncmp(c, keyword, keyword_len) == 0 
+        && parse_is_space(c[keyword_len]);
+}
+
+char* parse_token(char* c, char* end, char* result, u64 max_len) {
+    c = parse_skip_spaces(c, end);
+    u64 len = 0;
+    while (c < end && *c != '\n' && !parse_is_space(*c)) {
+        if (len + 1 < max_len) result[len++] = *c;
+        c++;
+    }
+    result[len] = 0;
+    return c;
+}
+
+char* parse_i32(char* c, char* end, i32* result) {
+    // Saturates at +-INT32_MAX, the digits past that are still consumed
+    bool negative = false;
+    if (c < end && (*c == '-' || *c == '+')) {
+        negative = (*c == '-');
+        c++;
+    }
+
+    u64 value = 0;
+    while (c < end && *c >= '0' && *c <= '9') {
+        value = value * 10 + (*c - '0');
+        if (value > INT32_MAX) value = INT32_MAX;
+        c++;
+    }
+    *result = negative ? -(i32)value : (i32)value;
+    return c;
+}
+
+char* parse_float(char* c, char* end, float* result) {
+    // Correctly rounded, see parsefloat.c. Exact in float arithmetic when the digits and
+    // the power of ten are both small, which covers most of what exporters write
+    static const float pow10[] = { 1e0f, 1e1f, 1e2f, 1e3f, 1e4f, 1e5f, 1e6f, 1e7f, 1e8f, 1e9f, 1e10f };
+
+    char* start = c;
+    bool negative = false;
+    if (c < end && (*c == '-' || *c == '+')) {
+        negative = (*c == '-');
+        c++;
+    }
+
+    // Accumulate up to 19 significant digits, the rest only shifts the exponent
+    u64 mantissa = 0;
+    i32 digit_count = 0;
+    i32 exponent = 0;
+    bool truncated = false; // Nonzero digits were dropped
+    while (c < end && *c >= '0' && *c <= '9') {
+        if (digit_count < 19) { mantissa = mantissa * 10 + (u64)(*c - '0'); digit_count += (mantissa != 0); }
+        else { exponent++; truncated |= (*c != '0'); }
+        c++;
+    }
+    if (c < end && *c == '.') {
+        c++;
+        while (c < end && *c >= '0' && *c <= '9') {
+            if (digit_count < 19) { mantissa = mantissa * 10 + (u64)(*c - '0'); digit_count += (mantissa != 0); exponent--; }
+            else { truncated |= (*c != '0'); }
+            c++;
+        }
+    }
+    if (c < end && (*c == 'e' || *c == 'E')) {
+        // Far past what a float can hold either way, and the sum can't overflow
+        i32 exponent_part;
+        c = parse_i32(c + 1, end, &exponent_part);
+        if (exponent_part > PARSEFLOAT_MAX_EXPONENT) exponent_part = PARSEFLOAT_MAX_EXPONENT;
+        if (exponent_part < -PARSEFLOAT_MAX_EXPONENT) exponent_part = -PARSEFLOAT_MAX_EXPONENT;
+        exponent += exponent_part;
+    }
+
+    if (!truncated && mantissa <= (1 << 24) && exponent >= -10 && exponent <= 10) {
+        float value = (float)mantissa;
+        value = (exponent < 0) ? value / pow10[-exponent] : value * pow10[exponent];
+        *result = negative ? -value : value;
+        return c;
+    }
+
+    u32 bits = parsefloat_eisel_lemire(mantissa, exponent);
+    if (truncated && parsefloat_eisel_lemire(mantissa + 1, exponent) != bits) {
+        // The dropped digits decide the rounding, slow path. The text isn't null-terminated,
+        // so it's copied, on the heap for the rare number that doesn't fit on the stack
+        char stack_text[128];
+        u64 len = (u64)(c - start);
+        char* text = (len < sizeof(stack_text)) ? stack_text : malloc(len + 1);
+        memcpy(text, start, len);
+        text[len] = 0;
+        *result = strtof(text, NULL);
+        if (text != stack_text) free(text);
+        return c;
+    }
+    if (negative) bits |= 0x80000000u;
+    memcpy(result, &bits, sizeof(float));
+    return c;
+}
+
+char* parse_floats(char* c, char* end, float* result, u32 count) {
+    for (u32 i = 0; i < count; i++) {
+        c = parse_skip_spaces(c, end);
+        c = parse_float(c, end, &result[i]);
+    }
+    return c;
+}
+
+bool parse_is_index_start(char c) {
+    return (c >= '0' && c <= '9') || c == '-' || c == '+';
+}
+
+char* parse_face_corner(char* c, char* end, objasset_t* obj_asset, u32* result) {
+    // "v", "v/u", "v//n" or "v/u/n", 1-based. Negative indices are relative to the
+    // current end of the list. Whatever is left out comes back as OBJ_INDEX_NONE
+    i32 indices[3] = { 0, 0, 0 };
+    u32 counts[3] = { obj_asset->position_count, obj_asset->uv_count, obj_asset->normal_count };
+    c = parse_skip_spaces(c, end);
+    c = parse_i32(c, end, &indices[0]);
+    for (u32 i = 1; i < 3 && c < end && *c == '/'; i++) {
+        c = parse_i32(c + 1, end, &indices[i]);
+    }
+
+    for (u32 i = 0; i < 3; i++) {
+        if (indices[i] == 0)     result[i] = OBJ_INDEX_NONE;
+        else if (indices[i] < 0) result[i] = (u32)((i32)counts[i] + indices[i]);
+        else                     result[i] = (u32)(indices[i] - 1);
+    }
+    return c;
+}
+
+bool parse_is_number(char* token) {
+    // "1", "-0.5", ".5", "1e3", but not "-s" or "1x". The whole token has to go through parse_float
+    char* c = (token[0] == '-' || token[0] == '+') ? token + 1 : token;
+    if (!((*c >= '0' && *c <= '9') || (*c == '.' && c[1] >= '0' && c[1] <= '9'))) return false;
+    char* end = token + strlen(token);
+    float value;
+    return parse_float(token, end, &value) == end;
+}
+
+void mtl_get_option_arity(char* option, u32* p_min_value_count, u32* p_max_value_count) {
+    // How many values follow a texture map option. -o, -s and -t take "u [v [w]]"
+    if (strcmp(option, "-o") == 0 || strcmp(option, "-s") == 0 || strcmp(option, "-t") == 0) {
+        *p_min_value_count = 1;
+        *p_max_value_count = 3;
+    } else if (strcmp(option, "-mm") == 0) {
+        *p_min_value_count = 2; // Base and gain
+        *p_max_value_count = 2;
+    } else {
+        *p_min_value_count = 1; // -blendu, -blendv, -bm, -boost, -cc, -clamp, -imfchan, -texres, -type, -colorspace
+        *p_max_value_count = 1;
+    }
+}
+
 void read_mtl_file(char* filename, mtlasset_t* mtl_asset) {
     memset(mtl_asset, 0, sizeof(mtlasset_t));
 
     char mtl_file_path[MTL_FILENAME_LEN] = { 0 };
     append_prefix(filename, "models/", MTL_FILENAME_LEN, mtl_file_path);
 
-    char* mtl_next_line_char;
-    char* mtl_file_content = read_entire_file(mtl_file_path);
-    char* mtl_line = strtok_s(mtl_file_content, "\n", &mtl_next_line_char);
+    filemap_t mtl_file = read_entire_file(mtl_file_path);
+    char* c = (char*)mtl_file.data;
+    char* end = c + mtl_file.size;
     i32 i_curr_mtl = -1;
-    while(mtl_line != NULL) {
-        if (strncmp(mtl_line, "newmtl", 6) == 0) {
+    while (c < end) {
+        c = parse_skip_spaces(c, end);
+        if (parse_keyword(c, end, "newmtl", 6)) {
             i_curr_mtl++;
-            sscanf_s(mtl_line, "newmtl %s", &(mtl_asset->materials[i_curr_mtl].name), MTL_NAME_LEN);
+            assert(i_curr_mtl < MTL_MAX_COUNT);
+            parse_token(c + 6, end, mtl_asset->materials[i_curr_mtl].name, MTL_NAME_LEN);
         }
-        else if (strncmp(mtl_line, "map_Kd", 6) == 0) {
-            sscanf_s(mtl_line, "map_Kd %s", &(mtl_asset->materials[i_curr_mtl].texture_name), MTL_TEXTURE_FILENAME_LEN);
+        else if (parse_keyword(c, end, "map_Kd", 6) && i_curr_mtl >= 0) {
+            // "map_Kd [-option value ...] file.png", the file name comes last.
+            // "-colorspace srgb" is our hint for the texture loader
+            mtldata_t* p_material = &mtl_asset->materials[i_curr_mtl];
+            char token[MTL_TEXTURE_FILENAME_LEN];
+            char* token_end = parse_token(c + 6, end, token, MTL_TEXTURE_FILENAME_LEN);
+            while (token[0] == '-') {
+                u32 min_value_count, max_value_count;
+                mtl_get_option_arity(token, &min_value_count, &max_value_count);
+                bool is_colorspace = (strcmp(token, "-colorspace") == 0);
+                for (u32 i = 0; i < max_value_count; i++) {
+                    char value[MTL_TEXTURE_FILENAME_LEN];
+                    char* value_end = parse_token(token_end, end, value, MTL_TEXTURE_FILENAME_LEN);
+                    if (i >= min_value_count && !parse_is_number(value)) break; // Optional values left out
+                    if (is_colorspace && _stricmp(value, "srgb") == 0) p_material->texture_flags |= TEXTURE_FLAG_SRGB;
+                    token_end = value_end;
+                }
+                token_end = parse_token(token_end, end, token, MTL_TEXTURE_FILENAME_LEN);
+            }
+            strcpy_s(p_material->texture_name, MTL_TEXTURE_FILENAME_LEN, token);
         }
 
-        mtl_line = strtok_s(NULL, "\n", &mtl_next_line_char);
+        c = parse_skip_line(c, end);
     }
     mtl_asset->mtl_count = (i_curr_mtl + 1);
 
-    free(mtl_file_content);
+    unmap_file(&mtl_file);
 }
 
-void read_obj_file(char* filename, mesh_t** pp_meshes, u32* mesh_count) {
-    char* obj_file_content = read_entire_file(filename);
-    objasset_t obj_asset = { 0 };
+void obj_build_indexed_mesh(objasset_t* obj_asset, objsubdata_t* sub, mesh_t* p_mesh, arena_t* mesh_arena) {
+    // Each face corner is a v/u/n triple. Corners with the same triple are the same
+    // vertex, so they're deduplicated with an open-addressing hash table of vertex indices.
+    // The table is scratch, only the vertex and index data go to "mesh_arena"
+    u32 corner_count = sub->face_count * 3;
+    u32* indices = arena_push(mesh_arena, corner_count * sizeof(u32));
+
+    u64 scratch_mark = arena_mark(obj_asset->arena);
+    u32 table_size = 64;
+    while (table_size < corner_count * 2) table_size *= 2;
+    u32* table = arena_push(obj_asset->arena, table_size * sizeof(u32));
+    memset(table, 0xFF, table_size * sizeof(u32)); // 0xFFFFFFFF is empty
+
+    u32* vertex_keys = arena_push(obj_asset->arena, corner_count * 3 * sizeof(u32)); // Triple of each unique vertex
+    u32 vertex_count = 0;
+
+    for (u32 i_corner = 0; i_corner < corner_count; i_corner++) {
+        u32* key = &sub->face_data[i_corner * 3];
+        u32 hash = (key[0] * 73856093u) ^ (key[1] * 19349663u) ^ (key[2] * 83492791u);
+        u32 slot = hash & (table_size - 1);
+        while (true) {
+            u32 i_vertex = table[slot];
+            if (i_vertex == 0xFFFFFFFF) {
+                i_vertex = vertex_count++;
+                table[slot] = i_vertex;
+                memcpy(&vertex_keys[i_vertex * 3], key, 3 * sizeof(u32));
+                indices[i_corner] = i_vertex;
+                break;
+            }
+            if (memcmp(&vertex_keys[i_vertex * 3], key, 3 * sizeof(u32)) == 0) {
+                indices[i_corner] = i_vertex;
+                break;
+            }
+            slot = (slot + 1) & (table_size - 1);
+        }
+    }
 
-    u32 position_count = 0;
-    u32 uv_count = 0;
-    u32 normal_count = 0;
-    u32 mtl_count = 0;
-
-    // Avoiding having another copy of the file contents to use strtok
-    // by counting the substrings. Careful, this wouldn't ignore the comments
-    // https://stackoverflow.com/a/9052540/4894526
-    char* tmp = obj_file_content;
-    while ((tmp = strstr(tmp, "v "))) { tmp++; position_count++; }
-    tmp = obj_file_content;
-    while ((tmp = strstr(tmp, "vt "))) { tmp++; uv_count++; }
-    tmp = obj_file_content;
-    while ((tmp = strstr(tmp, "vn "))) { tmp++; normal_count++; }
-    tmp = obj_file_content;
-    while ((tmp = strstr(tmp, "usemtl "))) { tmp++; mtl_count++; }
+    // Vertex data format: v,v,v, u,u, n,n,n. A missing or out of range uv is zero,
+    // a missing normal is generated below
+    p_mesh->vertex_count = vertex_count;
+    p_mesh->vertex_data = arena_push(mesh_arena, vertex_count * 8 * sizeof(float));
+    u32 bad_index_count = 0;
+    bool has_missing_normals = false;
+    for (u32 i_vertex = 0; i_vertex < vertex_count; i_vertex++) {
+        u32 i_pos    = vertex_keys[i_vertex * 3 + 0];
+        u32 i_uv     = vertex_keys[i_vertex * 3 + 1];
+        u32 i_normal = vertex_keys[i_vertex * 3 + 2];
+        float* vertex = &p_mesh->vertex_data[i_vertex * 8];
+        memset(vertex, 0, 8 * sizeof(float));
+        if (i_pos < obj_asset->position_count) memcpy(&vertex[0], &obj_asset->positions[i_pos * 3], 3 * sizeof(float));
+        else bad_index_count++;
+        if (i_uv < obj_asset->uv_count) memcpy(&vertex[3], &obj_asset->uvs[i_uv * 2], 2 * sizeof(float));
+        else bad_index_count += (i_uv != OBJ_INDEX_NONE);
+        if (i_normal < obj_asset->normal_count) memcpy(&vertex[5], &obj_asset->normals[i_normal * 3], 3 * sizeof(float));
+        else { has_missing_normals = true; bad_index_count += (i_normal != OBJ_INDEX_NONE); }
+    }
+    if (bad_index_count > 0) {
+        printf("%u face indices out of range in %s\n", bad_index_count, sub->mtl_name);
+    }
+
+    if (has_missing_normals) {
+        // Smooth normals, the sum of the (area weighted) normals of the faces around the vertex
+        for (u32 i_corner = 0; i_corner < corner_count; i_corner += 3) {
+            float* v0 = &p_mesh->vertex_data[indices[i_corner + 0] * 8];
+            float* v1 = &p_mesh->vertex_data[indices[i_corner + 1] * 8];
+            float* v2 = &p_mesh->vertex_data[indices[i_corner + 2] * 8];
+            vec3 e1 = v3_sub((vec3){ v1[0], v1[1], v1[2] }, (vec3){ v0[0], v0[1], v0[2] });
+            vec3 e2 = v3_sub((vec3){ v2[0], v2[1], v2[2] }, (vec3){ v0[0], v0[1], v0[2] });
+            vec3 face_normal = v3_cross(e1, e2);
+            for (u32 k = 0; k < 3; k++) {
+                u32 i_vertex = indices[i_corner + k];
+                if (vertex_keys[i_vertex * 3 + 2] < obj_asset->normal_count) continue;
+                float* normal = &p_mesh->vertex_data[i_vertex * 8 + 5];
+                normal[0] += face_normal.x;
+                normal[1] += face_normal.y;
+                normal[2] += face_normal.z;
+            }
+        }
+        for (u32 i_vertex = 0; i_vertex < vertex_count; i_vertex++) {
+            if (vertex_keys[i_vertex * 3 + 2] < obj_asset->normal_count) continue;
+            float* normal = &p_mesh->vertex_data[i_vertex * 8 + 5];
+            vec3 n = { normal[0], normal[1], normal[2] };
+            if (v3_iszero(n)) continue; // Only degenerate faces around it
+            n = v3_norm(n);
+            normal[0] = n.x;
+            normal[1] = n.y;
+            normal[2] = n.z;
+        }
+    }
+
+    // 16-bit indices whenever they fit. Narrowing in place is safe since
+    // the write position never passes the read position
+    p_mesh->index_count = corner_count;
+    p_mesh->index_data = indices;
+    p_mesh->index_size = sizeof(u32);
+    p_mesh->lod_count = 1;
+    p_mesh->lods[0].first_index = 0;
+    p_mesh->lods[0].index_count = corner_count;
+    p_mesh->lods[0].error = 0.0f;
+    p_mesh->meshlets = NULL;
+    p_mesh->meshlet_count = 0;
+    if (vertex_count <= 0x10000) {
+        u16* indices16 = (u16*)indices;
+        for (u32 i = 0; i < corner_count; i++) {
+            indices16[i] = (u16)indices[i];
+        }
+        p_mesh->index_size = sizeof(u16);
+    }
+
+    arena_pop_to(obj_asset->arena, scratch_mark);
+}
+
+i32 obj_find_or_add_sub(objasset_t* obj_asset, char* mtl_name) {
+    // Switching back to a material appends to its existing face list, so a file
+    // with many usemtl switches still ends up with one group per material.
+    // There are only a handful of materials, a linear search is fine
+    for (u32 i = 0; i < obj_asset->mtl_count; i++) {
+        if (strcmp(obj_asset->subs[i].mtl_name, mtl_name) == 0) {
+            return (i32)i;
+        }
+    }
+
+    obj_asset->subs = array_reserve(obj_asset->arena, obj_asset->subs, obj_asset->mtl_count, &obj_asset->mtl_capacity, 1, sizeof(objsubdata_t));
+    objsubdata_t* new_sub = &obj_asset->subs[obj_asset->mtl_count];
+    memset(new_sub, 0, sizeof(objsubdata_t));
+    strcpy_s(new_sub->mtl_name, MTL_NAME_LEN, mtl_name);
+    return (i32)obj_asset->mtl_count++;
+}
+
+void obj_get_texture(mtlasset_t* mtl_asset, char* mtl_name, mesh_t* p_mesh) {
+    mtldata_t* p_face_mat = NULL;
+    for (u32 i = 0; i < mtl_asset->mtl_count; i++) {
+        if (strcmp(mtl_asset->materials[i].name, mtl_name) == 0) {
+            p_face_mat = &(mtl_asset->materials[i]);
+            break;
+        }
+    }
+    assert(p_face_mat);
+
+    append_prefix(p_face_mat->texture_name, "textures/", MTL_TEXTURE_FILENAME_LEN, p_mesh->texture_name);
+    p_mesh->texture_flags = p_face_mat->texture_flags;
+}
+
+void obj_parse_range(objasset_t* obj_asset, char* c, char* end) {
+    // Faces before any usemtl go into a group with an empty name. For a chunk
+    // in the middle of the file, those belong to whatever material was active
+    // at the end of the previous chunk
+    i32 i_curr_mtl = obj_asset->i_curr_mtl;
+    while (c < end) {
+        c = parse_skip_spaces(c, end);
+
+        if (parse_keyword(c, end, "v", 1)) {
+            obj_asset->positions = array_reserve(obj_asset->arena, obj_asset->positions, obj_asset->position_count, &obj_asset->position_capacity, 1, 3 * sizeof(float));
+            c = parse_floats(c + 1, end, &obj_asset->positions[obj_asset->position_count * 3], 3);
+            obj_asset->position_count++;
+        } else if (parse_keyword(c, end, "vt", 2)) {
+            obj_asset->uvs = array_reserve(obj_asset->arena, obj_asset->uvs, obj_asset->uv_count, &obj_asset->uv_capacity, 1, 2 * sizeof(float));
+            c = parse_floats(c + 2, end, &obj_asset->uvs[obj_asset->uv_count * 2], 2);
+            obj_asset->uv_count++;
+        } else if (parse_keyword(c, end, "vn", 2)) {
+            obj_asset->normals = array_reserve(obj_asset->arena, obj_asset->normals, obj_asset->normal_count, &obj_asset->normal_capacity, 1, 3 * sizeof(float));
+            c = parse_floats(c + 2, end, &obj_asset->normals[obj_asset->normal_count * 3], 3);
+            obj_asset->normal_count++;
+        } else if (parse_keyword(c, end, "f", 1)) {
+            if (i_curr_mtl < 0) {
+                i_curr_mtl = obj_find_or_add_sub(obj_asset, "");
+            }
+
+            // Polygons are split into a fan around their first corner
+            objsubdata_t* curr_sub = &obj_asset->subs[i_curr_mtl];
+            u32 first[3], prev[3], curr[3];
+            c = parse_face_corner(c + 1, end, obj_asset, first);
+            c = parse_face_corner(c, end, obj_asset, prev);
+            while (true) {
+                c = parse_skip_spaces(c, end);
+                if (c >= end || !parse_is_index_start(*c)) break;
+                c = parse_face_corner(c, end, obj_asset, curr);
+
+                curr_sub->face_data = array_reserve(obj_asset->arena, curr_sub->face_data, curr_sub->face_count, &curr_sub->face_capacity, 1, 9 * sizeof(u32));
+                u32* face = &curr_sub->face_data[curr_sub->face_count * 9];
+                memcpy(&face[0], first, sizeof(first));
+                memcpy(&face[3], prev, sizeof(prev));
+                memcpy(&face[6], curr, sizeof(curr));
+                curr_sub->face_count++;
+                memcpy(prev, curr, sizeof(curr));
+            }
+        } else if (parse_keyword(c, end, "mtllib", 6)) {
+            parse_token(c + 6, end, obj_asset->mtllib_name, MTL_FILENAME_LEN);
+        } else if (parse_keyword(c, end, "usemtl", 6)) {
+            char mtl_curr_name[MTL_NAME_LEN];
+            parse_token(c + 6, end, mtl_curr_name, MTL_NAME_LEN);
+            i_curr_mtl = obj_find_or_add_sub(obj_asset, mtl_curr_name);
+        }
+
+        // Anything else ("#", "o", "g", "s", blank lines) is skipped entirely
+        c = parse_skip_line(c, end);
+    } 
+    obj_asset->i_curr_mtl = i_curr_mtl;
+}
+
+//
+// Parallel parsing. The buffer is split into newline-aligned chunks, and the
+// chunks are parsed twice: first only counting attribute lines, then for real.
+// A prefix sum over the counts gives each chunk its place in the global
+// attribute arrays, so every chunk writes straight into them and resolves
+// relative (negative) indices exactly like the serial parse. Face groups are
+// per chunk, and get appended to the global groups in chunk order
+//
+
+typedef struct {
+    char* begin;
+    char* end;
+    objasset_t asset; // Attribute arrays point into the global ones
+    u32 position_count; // Counted in the first pass
+    u32 uv_count;
+    u32 normal_count;
+} objchunk_t;
+
+DWORD WINAPI obj_count_chunk_thread(LPVOID param) {
+    objchunk_t* chunk = param;
+    char* c = chunk->begin;
+    while (c < chunk->end) {
+        c = parse_skip_spaces(c, chunk->end);
+        if (parse_keyword(c, chunk->end, "v", 1)) chunk->position_count++;
+        else if (parse_keyword(c, chunk->end, "vt", 2)) chunk->uv_count++;
+        else if (parse_keyword(c, chunk->end, "vn", 2)) chunk->normal_count++;
+        c = parse_skip_line(c, chunk->end);
+    }
+    return 0;
+}
+
+DWORD WINAPI obj_parse_chunk_thread(LPVOID param) {
+    objchunk_t* chunk = param;
+    obj_parse_range(&chunk->asset, chunk->begin, chunk->end);
+    return 0;
+}
+
+void obj_run_chunk_threads(LPTHREAD_START_ROUTINE thread_func, objchunk_t* chunks, u32 chunk_count) {
+    // A chunk that couldn't get a thread is done on the calling one, each chunk has its own arena
+    HANDLE threads[OBJ_PARSE_MAX_THREADS];
+    u32 started_count = 0;
+    for (u32 i = 0; i < chunk_count; i++) {
+        HANDLE thread = CreateThread(NULL, 0, thread_func, &chunks[i], 0, NULL);
+        if (thread != NULL) threads[started_count++] = thread;
+        else thread_func(&chunks[i]);
+    }
+    if (started_count > 0) WaitForMultipleObjects(started_count, threads, TRUE, INFINITE);
+    for (u32 i = 0; i < started_count; i++) {
+        CloseHandle(threads[i]);
+    }
+}
+
+u32 obj_parse_thread_count(u64 file_size) {
+    SYSTEM_INFO system_info;
+    GetSystemInfo(&system_info);
+    u64 thread_count = file_size / OBJ_PARSE_MIN_CHUNK_SIZE;
+    if (thread_count > system_info.dwNumberOfProcessors) thread_count = system_info.dwNumberOfProcessors;
+    if (thread_count > OBJ_PARSE_MAX_THREADS) thread_count = OBJ_PARSE_MAX_THREADS;
+    return (thread_count < 1) ? 1 : (u32)thread_count;
+}
+
+void obj_parse_parallel(objasset_t* obj_asset, char* begin, char* end, u32 thread_count) {
+    assert(thread_count >= 1 && thread_count <= OBJ_PARSE_MAX_THREADS);
+    objchunk_t chunks[OBJ_PARSE_MAX_THREADS] = { 0 };
+
+    u64 chunk_size = (u64)(end - begin) / thread_count;
+    char* chunk_begin = begin;
+    for (u32 i = 0; i < thread_count; i++) {
+        char* chunk_end = (i == thread_count - 1) ? end : chunk_begin + chunk_size;
+        if (chunk_end > end) chunk_end = end;
+        chunk_end = parse_skip_line(chunk_end, end); // Up to and including the next '\n'
+        chunks[i].begin = chunk_begin;
+        chunks[i].end = chunk_end;
+        chunks[i].asset.i_curr_mtl = -1;
+        chunks[i].asset.arena = get_scratch_arena(i + 1); // Workers can't share the caller's arena
+        chunk_begin = chunk_end;
+    }
+
+    obj_run_chunk_threads(obj_count_chunk_thread, chunks, thread_count);
+
+    // Prefix sum of the attribute counts
+    u32 position_total = 0, uv_total = 0, normal_total = 0;
+    for (u32 i = 0; i < thread_count; i++) {
+        objasset_t* chunk_asset = &chunks[i].asset;
+        chunk_asset->position_count = position_total;
+        chunk_asset->uv_count = uv_total;
+        chunk_asset->normal_count = normal_total;
+        position_total += chunks[i].position_count;
+        uv_total += chunks[i].uv_count;
+        normal_total += chunks[i].normal_count;
+        chunk_asset->position_capacity = position_total;
+        chunk_asset->uv_capacity = uv_total;
+        chunk_asset->normal_capacity = normal_total;
+    }
+
+    obj_asset->positions = arena_push(obj_asset->arena, position_total * 3 * sizeof(float));
+    obj_asset->uvs = arena_push(obj_asset->arena, uv_total * 2 * sizeof(float));
+    obj_asset->normals = arena_push(obj_asset->arena, normal_total * 3 * sizeof(float));
+    obj_asset->position_count = obj_asset->position_capacity = position_total;
+    obj_asset->uv_count = obj_asset->uv_capacity = uv_total;
+    obj_asset->normal_count = obj_asset->normal_capacity = normal_total;
+    for (u32 i = 0; i < thread_count; i++) {
+        chunks[i].asset.positions = obj_asset->positions;
+        chunks[i].asset.uvs = obj_asset->uvs;
+        chunks[i].asset.normals = obj_asset->normals;
+    }
+
+    obj_run_chunk_threads(obj_parse_chunk_thread, chunks, thread_count);
+
+    // Stitch the face groups together in file order
+    i32 i_curr_mtl = -1;
+    for (u32 i_chunk = 0; i_chunk < thread_count; i_chunk++) {
+        objasset_t* chunk_asset = &chunks[i_chunk].asset;
+        assert(chunk_asset->position_count == chunk_asset->position_capacity);
+        if (obj_asset->mtllib_name[0] == 0) {
+            strcpy_s(obj_asset->mtllib_name, MTL_FILENAME_LEN, chunk_asset->mtllib_name);
+        }
+
+        i32 i_chunk_last_mtl = i_curr_mtl;
+        for (u32 i_sub = 0; i_sub < chunk_asset->mtl_count; i_sub++) {
+            objsubdata_t* chunk_sub = &chunk_asset->subs[i_sub];
+            bool inherited = chunk_sub->mtl_name[0] == 0 && i_curr_mtl >= 0;
+            i32 i_mtl = inherited ? i_curr_mtl : obj_find_or_add_sub(obj_asset, chunk_sub->mtl_name);
+            if ((i32)i_sub == chunk_asset->i_curr_mtl) i_chunk_last_mtl = i_mtl;
+
+            objsubdata_t* sub = &obj_asset->subs[i_mtl];
+            if (sub->face_count == 0) {
+                // Nothing to append to, take the chunk's array as is. It lives
+                // in the worker's scratch arena, which is reset with the caller's
+                sub->face_data = chunk_sub->face_data;
+                sub->face_count = chunk_sub->face_count;
+                sub->face_capacity = chunk_sub->face_capacity;
+            } else {
+                sub->face_data = array_reserve(obj_asset->arena, sub->face_data, sub->face_count, &sub->face_capacity, chunk_sub->face_count, 9 * sizeof(u32));
+                memcpy(&sub->face_data[sub->face_count * 9], chunk_sub->face_data, chunk_sub->face_count * 9 * sizeof(u32));
+                sub->face_count += chunk_sub->face_count;
+            }
+        }
+        i_curr_mtl = i_chunk_last_mtl;
+    }
+}
+
+void read_obj_file(char* filename, mesh_t** pp_meshes, u32* mesh_count, arena_t* mesh_arena) {
+    // Everything except the meshes themselves is scratch, and goes away with one
+    // reset at the end. The meshes are allocated from "mesh_arena", which the
+    // caller can drop once they're uploaded
+    double load_start_time = glfwGetTime();
+    filemap_t obj_file = read_entire_file(filename);
+    char* obj_file_content = (char*)obj_file.data;
+    char* end = obj_file_content + obj_file.size;
+    objasset_t obj_asset = { 0 };
+    obj_asset.i_curr_mtl = -1;
+    obj_asset.arena = get_scratch_arena(0);
 
     //
-    // Parse data out of the file
+    // Parse data out of the file, in a single pass. Large files are split
+    // across threads, small ones go through the serial path
     // 
 
-    obj_asset.positions = malloc(position_count * 3 * sizeof(float));
-    obj_asset.uvs = malloc(uv_count * 2 * sizeof(float));
-    obj_asset.normals = malloc(normal_count * 3 * sizeof(float));
-    obj_asset.subs = malloc(mtl_count * sizeof(objsubdata_t));
-    u32 positions_index = 0;
-    u32 uvs_index = 0;
-    u32 normals_index = 0;
+    u32 thread_count = obj_parse_thread_count((u64)(end - obj_file_content));
+    if (thread_count > 1) {
+        obj_parse_parallel(&obj_asset, obj_file_content, end, thread_count);
+    } else {
+        obj_parse_range(&obj_asset, obj_file_content, end);
+    }
+
+    for (u32 i = 0; i < obj_asset.mtl_count; i++) {
+        if (obj_asset.subs[i].mtl_name[0] == 0 && obj_asset.subs[i].face_count > 0) {
+            printf("face without usemtl in: %s\n", filename);
+            assert(false);
+        }
+    }
 
     mtlasset_t mtl_asset = { 0 };
-    char mtl_curr_name[MTL_NAME_LEN];
-    i32 i_curr_mtl = -1;
-    u32 i_curr_face = 0;
+    if (obj_asset.mtllib_name[0] != 0) {
+        read_mtl_file(obj_asset.mtllib_name, &mtl_asset);
+    }
+
+    // Each mtl means a mesh, unless no faces ended up using it
+    *mesh_count = 0;
+    *pp_meshes = arena_push(mesh_arena, obj_asset.mtl_count * sizeof(mesh_t));
+
+    mesh_t* p_meshes = (*pp_meshes);
+
+    for (u32 i_mtl = 0; i_mtl < obj_asset.mtl_count; i_mtl++) {
+        objsubdata_t* curr_sub = &obj_asset.subs[i_mtl];
+        if (curr_sub->face_count == 0) continue;
 
-    char* obj_file_content_rest;
-    char* line = strtok_s(obj_file_content, "\n", &obj_file_content_rest);
+        mesh_t* p_curr_mesh = &(p_meshes[(*mesh_count)++]);
+
+        obj_get_texture(&mtl_asset, curr_sub->mtl_name, p_curr_mesh);
+        obj_build_indexed_mesh(&obj_asset, curr_sub, p_curr_mesh, mesh_arena);
+        float acmr_before, atvr_before, acmr_after, atvr_after;
+        mesh_get_cache_stats(p_curr_mesh, &acmr_before, &atvr_before);
+        mesh_optimize(p_curr_mesh, true, obj_asset.arena);
+        mesh_get_cache_stats(p_curr_mesh, &acmr_after, &atvr_after);
+
+        u64 expanded_size = (u64)curr_sub->face_count * 3 * 8 * sizeof(float);
+        u64 indexed_size = (u64)p_curr_mesh->vertex_count * 8 * sizeof(float) + (u64)p_curr_mesh->index_count * p_curr_mesh->index_size;
+        printf("  %s: %u -> %u vertices, %llu -> %llu bytes, ACMR %.3f -> %.3f, ATVR %.3f -> %.3f\n", 
+                p_curr_mesh->texture_name, curr_sub->face_count * 3, p_curr_mesh->vertex_count, 
+                (unsigned long long)expanded_size, (unsigned long long)indexed_size, acmr_before, acmr_after, atvr_before, atvr_after);
+
+        mesh_generate_lods(p_curr_mesh, mesh_arena, obj_asset.arena);
+        for (u32 i_lod = 1; i_lod < p_curr_mesh->lod_count; i_lod++) {
+            printf("    lod %u: %u triangles, error %.4f\n", i_lod, p_curr_mesh->lods[i_lod].index_count / 3, p_curr_mesh->lods[i_lod].error);
+        }
+        mesh_build_meshlets(p_curr_mesh, mesh_arena, obj_asset.arena);
+        if (p_curr_mesh->meshlet_count > 0) {
+            u32 meshlet_vertex_count = 0;
+            u32 cullable_count = 0;
+            for (u32 i = 0; i < p_curr_mesh->meshlet_count; i++) {
+                meshlet_vertex_count += p_curr_mesh->meshlets[i].vertex_count;
+                if (p_curr_mesh->meshlets[i].cone_cutoff < 1.0f) cullable_count++;
+            }
+            printf("    meshlets: %u, %.1f vertices and %.1f triangles each, %u with a normal cone\n", p_curr_mesh->meshlet_count,
+                    (float)meshlet_vertex_count / p_curr_mesh->meshlet_count, (float)(p_curr_mesh->lods[0].index_count / 3) / p_curr_mesh->meshlet_count, cullable_count);
+        }
+    }
+
+    double load_time = glfwGetTime() - load_start_time;
+    PROCESS_MEMORY_COUNTERS memory_counters = { 0 };
+    GetProcessMemoryInfo(GetCurrentProcess(), &memory_counters, sizeof(memory_counters));
+    printf("loaded %s: %.2f ms, %.1f MB/s, peak working set %.1f MB\n", filename, load_time * 1000.0, 
+            (double)obj_file.size / (1024.0 * 1024.0) / load_time, (double)memory_counters.PeakWorkingSetSize / (1024.0 * 1024.0));
+
+    print_arena_stats("scratch", obj_asset.arena);
+    if (thread_count > 1) {
+        arena_t worker_total = { 0 }; // Only for the stats
+        for (u32 i = 1; i <= thread_count; i++) {
+            worker_total.alloc_count += get_scratch_arena(i)->alloc_count;
+            worker_total.high_water += get_scratch_arena(i)->high_water;
+            worker_total.committed += get_scratch_arena(i)->committed;
+        }
+        print_arena_stats("worker scratch (total)", &worker_total);
+    }
+    print_arena_stats("meshes", mesh_arena);
+
+    unmap_file(&obj_file);
+    reset_scratch_arenas();
+}
+
+
+//
+// Streaming OBJ loading, for meshes that shouldn't be resident all at once.
+// The file goes through a fixed-size window instead of being mapped, and
+// whenever a material has gathered "batch_face_count" faces they're built
+// into an indexed mesh, handed to the callback and dropped. So the text and
+// the face/vertex data are bounded by the window and batch sizes. Attribute
+// arrays still grow with the file, since any face may reference any
+// earlier v/vt/vn line
+//
+
+void obj_emit_batch(objasset_t* obj_asset, objsubdata_t* sub, mtlasset_t* mtl_asset, arena_t* batch_arena, char* filename, objbatch_callback_t callback, void* user_data) {
+    if (sub->mtl_name[0] == 0) {
+        printf("face without usemtl in: %s\n", filename);
+        assert(false);
+    }
+
+    // The batch only lives during the callback, which uploads or copies it
+    mesh_t batch = { 0 };
+    obj_get_texture(mtl_asset, sub->mtl_name, &batch);
+    obj_build_indexed_mesh(obj_asset, sub, &batch, batch_arena);
+    mesh_optimize(&batch, true, obj_asset->arena);
+    callback(&batch, user_data);
+    arena_reset(batch_arena);
+
+    sub->face_count = 0; // Capacity is kept for the next batch
+}
+
+void read_obj_file_streaming(char* filename, u64 window_size, u32 batch_face_count, objbatch_callback_t callback, void* user_data) {
+    double load_start_time = glfwGetTime();
+    FILE* f = fopen(filename, "rb");
+    if (f == NULL) {
+        printf("file not found: %s\n", filename);
+        assert(false);
+    }
+
+    setvbuf(f, NULL, _IONBF, 0); // Reads go straight into the window
+
+    arena_t* batch_arena = get_scratch_arena(1);
+    objasset_t obj_asset = { 0 };
+    obj_asset.i_curr_mtl = -1;
+    obj_asset.arena = get_scratch_arena(0);
+    char* window = arena_push(obj_asset.arena, window_size);
+    mtlasset_t mtl_asset = { 0 };
+    bool mtl_loaded = false;
+    u64 file_size = 0;
+    u64 carry_size = 0; // Incomplete line at the end of the previous window
+    bool at_eof = false;
+    while (!at_eof) {
+        u64 read_size = fread(window + carry_size, 1, window_size - carry_size, f);
+        at_eof = read_size < window_size - carry_size;
+        file_size += read_size;
+
+        // Only complete lines are parsed, the rest is carried over to the next window
+        char* window_end = window + carry_size + read_size;
+        char* parse_end = window_end;
+        if (!at_eof) {
+            while (parse_end > window && parse_end[-1] != '\n') parse_end--;
+            if (parse_end == window) {
+                printf("line longer than the streaming window in: %s\n", filename);
+                assert(false);
+            }
+        }
+        obj_parse_range(&obj_asset, window, parse_end);
+
+        if (!mtl_loaded && obj_asset.mtllib_name[0] != 0) {
+            read_mtl_file(obj_asset.mtllib_name, &mtl_asset);
+            mtl_loaded = true;
+        }
+
+        for (u32 i = 0; i < obj_asset.mtl_count; i++) {
+            objsubdata_t* sub = &obj_asset.subs[i];
+            if (sub->face_count >= batch_face_count || (at_eof && sub->face_count > 0)) {
+                obj_emit_batch(&obj_asset, sub, &mtl_asset, batch_arena, filename, callback, user_data);
+            }
+        }
+
+        carry_size = (u64)(window_end - parse_end);
+        memmove(window, parse_end, carry_size);
+    }
+
+    double load_time = glfwGetTime() - load_start_time;
+    PROCESS_MEMORY_COUNTERS memory_counters = { 0 };
+    GetProcessMemoryInfo(GetCurrentProcess(), &memory_counters, sizeof(memory_counters));
+    printf("streamed %s: %.2f ms, %.1f MB/s, peak working set %.1f MB\n", filename, load_time * 1000.0, 
+            (double)file_size / (1024.0 * 1024.0) / load_time, (double)memory_counters.PeakWorkingSetSize / (1024.0 * 1024.0));
+
+    print_arena_stats("scratch", obj_asset.arena);
+    print_arena_stats("batches", batch_arena);
+
+    fclose(f);
+    reset_scratch_arenas();
+}
+
+void obj_stream_gather_batch(mesh_t* p_batch, void* user_data) {
+    // Appends the batch to the mesh of its texture. Vertices shared across
+    // batches are duplicated, each batch is deduplicated on its own
+    objstreammeshes_t* p_stream = user_data;
+    u32 i_mesh = 0;
+    while (i_mesh < p_stream->mesh_count 
+            && (strcmp(p_stream->meshes[i_mesh].texture_name, p_batch->texture_name) != 0 || p_stream->meshes[i_mesh].texture_flags != p_batch->texture_flags)) {
+        i_mesh++;
+    }
+    mesh_t* p_mesh = &p_stream->meshes[i_mesh];
+    if (i_mesh == p_stream->mesh_count) {
+        assert(p_stream->mesh_count < MTL_MAX_COUNT);
+        p_stream->mesh_count++;
+        memset(p_mesh, 0, sizeof(mesh_t));
+        memcpy(p_mesh->texture_name, p_batch->texture_name, MTL_TEXTURE_FILENAME_LEN);
+        p_mesh->texture_flags = p_batch->texture_flags;
+        p_mesh->index_size = sizeof(u32); // Narrowed once all batches are in
+    }
+
+    u32 first_vertex = p_mesh->vertex_count;
+    p_mesh->vertex_data = array_reserve(p_stream->mesh_arena, p_mesh->vertex_data, p_mesh->vertex_count, &p_stream->vertex_capacities[i_mesh], p_batch->vertex_count, 8 * sizeof(float));
+    memcpy(&p_mesh->vertex_data[first_vertex * 8], p_batch->vertex_data, p_batch->vertex_count * 8 * sizeof(float));
+    p_mesh->vertex_count += p_batch->vertex_count;
+
+    p_mesh->index_data = array_reserve(p_stream->mesh_arena, p_mesh->index_data, p_mesh->index_count, &p_stream->index_capacities[i_mesh], p_batch->index_count, sizeof(u32));
+    u32* indices = (u32*)p_mesh->index_data + p_mesh->index_count;
+    for (u32 i = 0; i < p_batch->index_count; i++) {
+        u32 index = (p_batch->index_size == sizeof(u16)) ? ((u16*)p_batch->index_data)[i] : ((u32*)p_batch->index_data)[i];
+        indices[i] = first_vertex + index;
+    }
+    p_mesh->index_count += p_batch->index_count;
+}
+
+void read_obj_file_streamed(char* filename, mesh_t** pp_meshes, u32* mesh_count, arena_t* mesh_arena) {
+    // Same result as read_obj_file, but the text never needs to be resident as a whole
+    objstreammeshes_t stream = { 0 };
+    stream.mesh_arena = mesh_arena;
+    stream.meshes = arena_push(mesh_arena, MTL_MAX_COUNT * sizeof(mesh_t));
+    read_obj_file_streaming(filename, OBJ_STREAM_WINDOW_SIZE, OBJ_STREAM_BATCH_FACES, obj_stream_gather_batch, &stream);
+
+    arena_t* scratch = get_scratch_arena(0);
+    for (u32 i = 0; i < stream.mesh_count; i++) {
+        mesh_t* p_mesh = &stream.meshes[i];
+        if (p_mesh->vertex_count <= 0x10000) {
+            u32* indices = p_mesh->index_data;
+            u16* indices16 = p_mesh->index_data;
+            for (u32 i_index = 0; i_index < p_mesh->index_count; i_index++) {
+                indices16[i_index] = (u16)indices[i_index];
+            }
+            p_mesh->index_size = sizeof(u16);
+        }
+        mesh_generate_lods(p_mesh, mesh_arena, scratch);
+        mesh_build_meshlets(p_mesh, mesh_arena, scratch);
+        printf("  %s: %u vertices, %u triangles, %u lods, %u meshlets\n", p_mesh->texture_name, 
+                p_mesh->vertex_count, p_mesh->index_count / 3, p_mesh->lod_count, p_mesh->meshlet_count);
+    }
+    reset_scratch_arenas();
+
+    *pp_meshes = stream.meshes;
+    *mesh_count = stream.mesh_count;
+}
+
+//
+// Baked mesh cache (.p7mesh)
+// Header, one entry per mesh, then the vertex/index blobs exactly as mesh_t
+// wants them. It's only used if the source .obj has the same size, mtime and hash,
+// and its .mtl the same size and mtime
+//
+
+u64 hash_fnv1a(u8* data, u64 size) {
+    // FNV-1a, but eating 8 bytes at a time. Only used to detect changes
+    u64 hash = 14695981039346656037ull;
+    u64 i = 0;
+    for (; i + 8 <= size; i += 8) {
+        u64 word;
+        memcpy(&word, data + i, sizeof(u64));
+        hash ^= word;
+        hash *= 1099511628211ull;
+    }
+    for (; i < size; i++) {
+        hash ^= data[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+bool mesh_cache_get_source_info(char* source_filename, meshcache_header_t* p_header) {
+    if (!get_file_info(source_filename, &(p_header->source_size), &(p_header->source_mtime))) return false;
+
+    filemap_t source_map = map_entire_file(source_filename, true);
+    if (source_map.data == NULL) return false;
+    p_header->source_hash = hash_fnv1a(source_map.data, source_map.size);
+
+    // Editing the .mtl changes the meshes' textures too. A missing one leaves zeros
+    char* c = (char*)source_map.data;
+    char* end = c + source_map.size;
+    p_header->mtl_size = 0;
+    p_header->mtl_mtime = 0;
+    while (c < end) {
+        c = parse_skip_spaces(c, end);
+        if (parse_keyword(c, end, "mtllib", 6)) {
+            char mtl_filename[MTL_FILENAME_LEN];
+            char mtl_file_path[MTL_FILENAME_LEN] = { 0 };
+            parse_token(c + 6, end, mtl_filename, MTL_FILENAME_LEN);
+            append_prefix(mtl_filename, "models/", MTL_FILENAME_LEN, mtl_file_path);
+            get_file_info(mtl_file_path, &(p_header->mtl_size), &(p_header->mtl_mtime));
+            break;
+        }
+        c = parse_skip_line(c, end);
+    }
+    unmap_file(&source_map);
+    return true;
+}
+
+void get_mesh_cache_filename(char* source_filename, char* result, u64 max_len) {
+    // "models/x.obj" -> "models/x.p7mesh"
+    strcpy_s(result, max_len, source_filename);
+    char* extension = strrchr(result, '.');
+    if (extension != NULL) *extension = 0;
+    strcat_s(result, max_len, ".p7mesh");
+}
+
+bool mesh_cache_range_valid(u64 offset, u64 size, u64 file_size) {
+    return offset <= file_size && size <= file_size - offset;
+}
+
+bool mesh_cache_entry_valid(meshcache_entry_t* p_entry, u8* file_data, u64 file_size) {
+    // Everything the meshes get from the cache has to stay inside the file and
+    // agree with itself, a truncated or stale file just gets rebuilt
+    if (p_entry->index_size != sizeof(u16) && p_entry->index_size != sizeof(u32)) return false;
+    if (p_entry->lod_count < 1 || p_entry->lod_count > MESH_MAX_LODS) return false;
+    if (memchr(p_entry->texture_name, 0, MTL_TEXTURE_FILENAME_LEN) == NULL) return false;
+    if (!mesh_cache_range_valid(p_entry->vertex_offset, (u64)p_entry->vertex_count * 8 * sizeof(float), file_size)) return false;
+    if (!mesh_cache_range_valid(p_entry->index_offset, (u64)p_entry->index_count * p_entry->index_size, file_size)) return false;
+    if (!mesh_cache_range_valid(p_entry->meshlet_offset, (u64)p_entry->meshlet_count * sizeof(meshlet_t), file_size)) return false;
+
+    for (u32 i = 0; i < p_entry->lod_count; i++) {
+        if ((u64)p_entry->lods[i].first_index + p_entry->lods[i].index_count > p_entry->index_count) return false;
+    }
+    meshlet_t* meshlets = (meshlet_t*)(file_data + p_entry->meshlet_offset);
+    for (u32 i = 0; i < p_entry->meshlet_count; i++) {
+        if ((u64)meshlets[i].first_index + (u64)meshlets[i].triangle_count * 3 > p_entry->lods[0].index_count) return false;
+    }
+
+    // The indices go to the GPU as they are
+    u32 max_index = 0;
+    for (u32 i = 0; i < p_entry->index_count; i++) {
+        u32 index = (p_entry->index_size == sizeof(u16)) 
+            ? ((u16*)(file_data + p_entry->index_offset))[i] 
+            : ((u32*)(file_data + p_entry->index_offset))[i];
+        if (index > max_index) max_index = index;
+    }
+    return p_entry->index_count == 0 || max_index < p_entry->vertex_count;
+}
+
+bool read_mesh_cache(char* source_filename, mesh_t** pp_meshes, u32* mesh_count, filemap_t* p_cache_map, arena_t* mesh_arena) {
+    char cache_filename[MTL_FILENAME_LEN + 8];
+    get_mesh_cache_filename(source_filename, cache_filename, sizeof(cache_filename));
+
+    filemap_t cache_map = map_entire_file(cache_filename, false);
+    if (cache_map.data == NULL) return false;
+
+    meshcache_header_t* p_header = (meshcache_header_t*)cache_map.data;
+    meshcache_header_t source_info = { 0 };
+    bool valid = cache_map.size >= sizeof(meshcache_header_t)
+        && p_header->magic == MESH_CACHE_MAGIC
+        && p_header->version == MESH_CACHE_VERSION
+        && cache_map.size >= sizeof(meshcache_header_t) + (u64)p_header->mesh_count * sizeof(meshcache_entry_t)
+        && mesh_cache_get_source_info(source_filename, &source_info)
+        && p_header->source_size == source_info.source_size
+        && p_header->source_mtime == source_info.source_mtime
+        && p_header->source_hash == source_info.source_hash
+        && p_header->mtl_size == source_info.mtl_size
+        && p_header->mtl_mtime == source_info.mtl_mtime;
+    if (!valid) {
+        unmap_file(&cache_map);
+        return false;
+    }
+
+    // The blobs are used in place, the mapping needs to stay alive until they're uploaded
+    meshcache_entry_t* entries = (meshcache_entry_t*)(cache_map.data + sizeof(meshcache_header_t));
+    for (u32 i = 0; i < p_header->mesh_count; i++) {
+        if (!mesh_cache_entry_valid(&entries[i], cache_map.data, cache_map.size)) {
+            printf("corrupt mesh cache, rebuilding: %s\n", cache_filename);
+            unmap_file(&cache_map);
+            return false;
+        }
+    }
+    *mesh_count = p_header->mesh_count;
+    *pp_meshes = arena_push(mesh_arena, p_header->mesh_count * sizeof(mesh_t));
+    for (u32 i = 0; i < p_header->mesh_count; i++) {
+        mesh_t* p_mesh = &((*pp_meshes)[i]);
+        p_mesh->vertex_data = (float*)(cache_map.data + entries[i].vertex_offset);
+        p_mesh->index_data = cache_map.data + entries[i].index_offset;
+        p_mesh->vertex_count = entries[i].vertex_count;
+        p_mesh->index_count = entries[i].index_count;
+        p_mesh->index_size = entries[i].index_size;
+        memcpy(p_mesh->texture_name, entries[i].texture_name, MTL_TEXTURE_FILENAME_LEN);
+        p_mesh->texture_flags = entries[i].texture_flags;
+        p_mesh->lod_count = entries[i].lod_count;
+        memcpy(p_mesh->lods, entries[i].lods, sizeof(p_mesh->lods));
+        p_mesh->meshlets = (meshlet_t*)(cache_map.data + entries[i].meshlet_offset);
+        p_mesh->meshlet_count = entries[i].meshlet_count;
+    }
+
+    *p_cache_map = cache_map;
+    return true;
+}
+
+void write_mesh_cache(char* source_filename, mesh_t* meshes, u32 mesh_count) {
+    if (vfs_is_mounted()) return; // The cache wouldn't be read from outside the pack, rebuild the pack instead
+    meshcache_header_t header = { 0 };
+    header.magic = MESH_CACHE_MAGIC;
+    header.version = MESH_CACHE_VERSION;
+    header.mesh_count = mesh_count;
+    if (!mesh_cache_get_source_info(source_filename, &header)) return;
+
+    // Written next to the cache and renamed over it once complete, so a failed
+    // write never leaves a half cache behind that reads as valid
+    char cache_filename[MTL_FILENAME_LEN + 8];
+    char temp_filename[MTL_FILENAME_LEN + 12];
+    get_mesh_cache_filename(source_filename, cache_filename, sizeof(cache_filename));
+    snprintf(temp_filename, sizeof(temp_filename), "%s.tmp", cache_filename);
+    FILE* f = fopen(temp_filename, "wb");
+    if (f == NULL) {
+        printf("can't write mesh cache: %s\n", cache_filename);
+        return;
+    }
+
+    // Blobs are 16-byte aligned
+    #define MESH_CACHE_ALIGN(x) (((x) + 15) & ~(u64)15)
+    arena_t* scratch = get_scratch_arena(0);
+    u64 scratch_mark = arena_mark(scratch);
+    meshcache_entry_t* entries = arena_push(scratch, mesh_count * sizeof(meshcache_entry_t));
+    memset(entries, 0, mesh_count * sizeof(meshcache_entry_t));
+    u64 offset = MESH_CACHE_ALIGN(sizeof(meshcache_header_t) + mesh_count * sizeof(meshcache_entry_t));
+    for (u32 i = 0; i < mesh_count; i++) {
+        entries[i].vertex_count = meshes[i].vertex_count;
+        entries[i].index_count = meshes[i].index_count;
+        entries[i].index_size = meshes[i].index_size;
+        memcpy(entries[i].texture_name, meshes[i].texture_name, MTL_TEXTURE_FILENAME_LEN);
+        entries[i].texture_flags = meshes[i].texture_flags;
+        entries[i].lod_count = meshes[i].lod_count;
+        memcpy(entries[i].lods, meshes[i].lods, sizeof(entries[i].lods));
+        entries[i].meshlet_count = meshes[i].meshlet_count;
+        entries[i].vertex_offset = offset;
+        offset = MESH_CACHE_ALIGN(offset + meshes[i].vertex_count * 8 * sizeof(float));
+        entries[i].index_offset = offset;
+        offset = MESH_CACHE_ALIGN(offset + meshes[i].index_count * meshes[i].index_size);
+        entries[i].meshlet_offset = offset;
+        offset = MESH_CACHE_ALIGN(offset + meshes[i].meshlet_count * sizeof(meshlet_t));
+    }
+
+    static const u8 padding[16] = { 0 };
+    bool ok = fwrite(&header, sizeof(header), 1, f) == 1;
+    ok = ok && fwrite(entries, sizeof(meshcache_entry_t), mesh_count, f) == mesh_count;
+    u64 written = sizeof(header) + mesh_count * sizeof(meshcache_entry_t);
+    for (u32 i = 0; ok && i < mesh_count; i++) {
+        u64 padding_size = entries[i].vertex_offset - written;
+        ok = ok && fwrite(padding, 1, padding_size, f) == padding_size;
+        ok = ok && fwrite(meshes[i].vertex_data, sizeof(float), meshes[i].vertex_count * 8, f) == meshes[i].vertex_count * 8;
+        written = entries[i].vertex_offset + meshes[i].vertex_count * 8 * sizeof(float);
+
+        padding_size = entries[i].index_offset - written;
+        ok = ok && fwrite(padding, 1, padding_size, f) == padding_size;
+        ok = ok && fwrite(meshes[i].index_data, meshes[i].index_size, meshes[i].index_count, f) == meshes[i].index_count;
+        written = entries[i].index_offset + meshes[i].index_count * meshes[i].index_size;
+
+        padding_size = entries[i].meshlet_offset - written;
+        ok = ok && fwrite(padding, 1, padding_size, f) == padding_size;
+        ok = ok && fwrite(meshes[i].meshlets, sizeof(meshlet_t), meshes[i].meshlet_count, f) == meshes[i].meshlet_count;
+        written = entries[i].meshlet_offset + meshes[i].meshlet_count * sizeof(meshlet_t);
+    }
+    #undef MESH_CACHE_ALIGN
+
+    ok = (fclose(f) == 0) && ok;
+    if (ok) ok = MoveFileExA(temp_filename, cache_filename, MOVEFILE_REPLACE_EXISTING);
+    if (!ok) {
+        printf("can't write mesh cache: %s\n", cache_filename);
+        DeleteFileA(temp_filename);
+    }
+    arena_pop_to(scratch, scratch_mark);
+}
+
+void load_obj_meshes(char* filename, mesh_t** pp_meshes, u32* mesh_count, filemap_t* p_cache_map, arena_t* mesh_arena) {
+    // Warm start: meshes point straight into the mapped cache, which the caller unmaps after upload
+    double load_start_time = glfwGetTime();
+    if (read_mesh_cache(filename, pp_meshes, mesh_count, p_cache_map, mesh_arena)) {
+        printf("loaded %s from mesh cache: %.2f ms\n", filename, (glfwGetTime() - load_start_time) * 1000.0);
+        return;
+    }
+
+    // Anything in the pack is mapped already, streaming only pays off for big loose files
+    u64 source_size, source_mtime;
+    if (!vfs_is_mounted() && get_file_info(filename, &source_size, &source_mtime) && source_size >= OBJ_STREAM_MIN_FILE_SIZE) {
+        read_obj_file_streamed(filename, pp_meshes, mesh_count, mesh_arena);
+    } else {
+        read_obj_file(filename, pp_meshes, mesh_count, mesh_arena);
+    }
+    write_mesh_cache(filename, *pp_meshes, *mesh_count);
+}
+
+void report_obj_meshes(char* directory) {
+    // Parses every model in the directory, skipping the mesh cache. read_obj_file
+    // prints each mesh's vertex cache stats before and after optimization
+    char pattern[MAX_PATH];
+    append_prefix("/*.obj", directory, MAX_PATH, pattern);
+    WIN32_FIND_DATAA find_data;
+    HANDLE find_handle = FindFirstFileA(pattern, &find_data);
+    if (find_handle == INVALID_HANDLE_VALUE) {
+        printf("no models in %s\n", directory);
+        return;
+    }
+
+    arena_t mesh_arena = arena_create(ARENA_RESERVE_SIZE);
+    do {
+        char filename[MAX_PATH];
+        snprintf(filename, MAX_PATH, "%s/%s", directory, find_data.cFileName);
+        mesh_t* meshes;
+        u32 mesh_count;
+        read_obj_file(filename, &meshes, &mesh_count, &mesh_arena);
+        arena_reset(&mesh_arena);
+    } while (FindNextFileA(find_handle, &find_data));
+    FindClose(find_handle);
+    arena_destroy(&mesh_arena);
+}
+
+void obj_parse_range_sscanf(objasset_t* obj_asset, char* text) {
+    // The line-by-line sscanf parser this file started out with, only kept to
+    // compare against. "text" is null-terminated, and gets cut into lines in place
+    i32 i_curr_mtl = -1;
+    char* rest;
+    char* line = strtok_s(text, "\n", &rest);
     while (line != NULL) {
         if (strncmp(line, "vt", 2) == 0) {
-            float u, v;
-            sscanf_s(line, "vt %f %f", &u, &v);
-            obj_asset.uvs[uvs_index++] = u;
-            obj_asset.uvs[uvs_index++] = v;
+            obj_asset->uvs = array_reserve(obj_asset->arena, obj_asset->uvs, obj_asset->uv_count, &obj_asset->uv_capacity, 1, 2 * sizeof(float));
+            float* uv = &obj_asset->uvs[obj_asset->uv_count++ * 2];
+            sscanf_s(line, "vt %f %f", &uv[0], &uv[1]);
         } else if (strncmp(line, "vn", 2) == 0) {
-            float norm_x, norm_y, norm_z;
-            sscanf_s(line, "vn %f %f %f", &norm_x, &norm_y, &norm_z);
-            obj_asset.normals[normals_index++] = norm_x;
-            obj_asset.normals[normals_index++] = norm_y;
-            obj_asset.normals[normals_index++] = norm_z;
+            obj_asset->normals = array_reserve(obj_asset->arena, obj_asset->normals, obj_asset->normal_count, &obj_asset->normal_capacity, 1, 3 * sizeof(float));
+            float* normal = &obj_asset->normals[obj_asset->normal_count++ * 3];
+            sscanf_s(line, "vn %f %f %f", &normal[0], &normal[1], &normal[2]);
         } else if (strncmp(line, "v", 1) == 0) {
-            float pos_x, pos_y, pos_z;
-            sscanf_s(line, "v %f %f %f", &pos_x, &pos_y, &pos_z);
-            obj_asset.positions[positions_index++] = pos_x;
-            obj_asset.positions[positions_index++] = pos_y;
-            obj_asset.positions[positions_index++] = pos_z;
+            obj_asset->positions = array_reserve(obj_asset->arena, obj_asset->positions, obj_asset->position_count, &obj_asset->position_capacity, 1, 3 * sizeof(float));
+            float* position = &obj_asset->positions[obj_asset->position_count++ * 3];
+            sscanf_s(line, "v %f %f %f", &position[0], &position[1], &position[2]);
         } else if (strncmp(line, "f", 1) == 0) {
+            if (i_curr_mtl < 0) i_curr_mtl = obj_find_or_add_sub(obj_asset, "");
+            objsubdata_t* curr_sub = &obj_asset->subs[i_curr_mtl];
+            curr_sub->face_data = array_reserve(obj_asset->arena, curr_sub->face_data, curr_sub->face_count, &curr_sub->face_capacity, 1, 9 * sizeof(u32));
+            u32* face = &curr_sub->face_data[curr_sub->face_count++ * 9];
+            sscanf_s(line, "f %u/%u/%u %u/%u/%u %u/%u/%u",
+                    &face[0], &face[1], &face[2], &face[3], &face[4], &face[5], &face[6], &face[7], &face[8]);
+        } else if (strncmp(line, "usemtl", 6) == 0) {
+            char mtl_curr_name[MTL_NAME_LEN];
+            sscanf_s(line, "usemtl %s", mtl_curr_name, MTL_NAME_LEN);
+            i_curr_mtl = obj_find_or_add_sub(obj_asset, mtl_curr_name);
+        }
+        line = strtok_s(NULL, "\n", &rest);
+    }
+}
 
-            u32 face_pos_0,  face_pos_1,  face_pos_2;
-            u32 face_uv_0,   face_uv_1,   face_uv_2;
-            u32 face_norm_0, face_norm_1, face_norm_2;
-            sscanf_s(line, "f %u/%u/%u %u/%u/%u %u/%u/%u", 
-                    &face_pos_0, &face_uv_0, &face_norm_0,
-                    &face_pos_1, &face_uv_1, &face_norm_1,
-                    &face_pos_2, &face_uv_2, &face_norm_2);
-
-            obj_asset.subs[i_curr_mtl].face_data[i_curr_face++] = face_pos_0;
-            obj_asset.subs[i_curr_mtl].face_data[i_curr_face++] = face_uv_0;
-            obj_asset.subs[i_curr_mtl].face_data[i_curr_face++] = face_norm_0;
-            obj_asset.subs[i_curr_mtl].face_data[i_curr_face++] = face_pos_1;
-            obj_asset.subs[i_curr_mtl].face_data[i_curr_face++] = face_uv_1;
-            obj_asset.subs[i_curr_mtl].face_data[i_curr_face++] = face_norm_1;
-            obj_asset.subs[i_curr_mtl].face_data[i_curr_face++] = face_pos_2;
-            obj_asset.subs[i_curr_mtl].face_data[i_curr_face++] = face_uv_2;
-            obj_asset.subs[i_curr_mtl].face_data[i_curr_face++] = face_norm_2;
-
-        } else if (strncmp(line, "mtllib", 6) == 0) {
-            char mtl_filename[MTL_FILENAME_LEN];
-            sscanf_s(line, "mtllib %s", mtl_filename, MTL_FILENAME_LEN);
-            read_mtl_file(mtl_filename, &mtl_asset);
+void bench_parse_obj(char* filename) {
+    // Parse throughput of the scanners against sscanf, on the text only: no
+    // mesh building, and the file is already in memory
+    filemap_t obj_file = read_entire_file(filename);
+    arena_t* scratch = get_scratch_arena(0);
+    char* text = arena_push(scratch, obj_file.size + 1); // sscanf needs it null-terminated
+    u64 scratch_mark = arena_mark(scratch);
 
-        } else if (strncmp(line, "usemtl", 6) == 0) {
-            sscanf_s(line, "usemtl %s", mtl_curr_name, MTL_FILENAME_LEN);
+    double best_times[2] = { 1e9, 1e9 };
+    u32 face_counts[2] = { 0, 0 };
+    for (u32 run = 0; run < OBJ_BENCH_RUNS; run++) {
+        for (u32 i_parser = 0; i_parser < 2; i_parser++) {
+            memcpy(text, obj_file.data, obj_file.size); // strtok writes into it
+            text[obj_file.size] = 0;
+            objasset_t obj_asset = { 0 };
+            obj_asset.i_curr_mtl = -1;
+            obj_asset.arena = scratch;
 
-            u32 face_count_this_mtl = 0;
-            for (char* ch = obj_file_content_rest; *ch != '\0' && strncmp(ch, "usemtl", 6) != 0; ch++) {
-                if (strncmp(ch, "f ", 2) == 0) {
-                    face_count_this_mtl++;
-                }
-            }
+            double start_time = glfwGetTime();
+            if (i_parser == 0) obj_parse_range(&obj_asset, text, text + obj_file.size);
+            else obj_parse_range_sscanf(&obj_asset, text);
+            best_times[i_parser] = fmin(best_times[i_parser], glfwGetTime() - start_time);
 
-            i_curr_mtl++;
-            i_curr_face = 0;
-            obj_asset.subs[i_curr_mtl].face_count = face_count_this_mtl;
-            obj_asset.subs[i_curr_mtl].face_data = malloc(face_count_this_mtl * 9 * sizeof(u32));
-            strcpy_s(obj_asset.subs[i_curr_mtl].mtl_name, MTL_NAME_LEN, mtl_curr_name);
+            face_counts[i_parser] = 0;
+            for (u32 i = 0; i < obj_asset.mtl_count; i++) face_counts[i_parser] += obj_asset.subs[i].face_count;
+            arena_pop_to(scratch, scratch_mark);
         }
+    }
 
-        line = strtok_s(NULL, "\n", &obj_file_content_rest);
-    } 
+    double size_mb = (double)obj_file.size / (1024.0 * 1024.0);
+    printf("obj parsing, %s (%.1f MB), best of %u:\n", filename, size_mb, OBJ_BENCH_RUNS);
+    printf("  scanners %8.1f MB/s, %u triangles\n", size_mb / best_times[0], face_counts[0]);
+    printf("  sscanf   %8.1f MB/s, %u triangles (only the first 3 corners of a face)\n", size_mb / best_times[1], face_counts[1]);
+    unmap_file(&obj_file);
+    reset_scratch_arenas();
+}
 
-    // Each mtl means a mesh
-    *mesh_count = (i_curr_mtl + 1);
-    *pp_meshes = malloc((*mesh_count) * sizeof(mesh_t));
+double get_peak_working_set_mb(void) {
+    PROCESS_MEMORY_COUNTERS memory_counters = { 0 };
+    GetProcessMemoryInfo(GetCurrentProcess(), &memory_counters, sizeof(memory_counters));
+    return (double)memory_counters.PeakWorkingSetSize / (1024.0 * 1024.0);
+}
 
-    mesh_t* p_meshes = (*pp_meshes);
+void bench_load_obj(char* filename) {
+    // Whole load times, streaming and parsing the .obj and from the mesh cache, and
+    // the peak working set after each. The peak only goes up, so the streamed load
+    // goes first and the parse is what sets it
+    double start_peak = get_peak_working_set_mb();
+    arena_t mesh_arena = arena_create(ARENA_RESERVE_SIZE);
+    mesh_t* meshes;
+    u32 mesh_count;
+    double stream_start_time = glfwGetTime();
+    read_obj_file_streamed(filename, &meshes, &mesh_count, &mesh_arena);
+    double stream_time = glfwGetTime() - stream_start_time;
+    double stream_peak = get_peak_working_set_mb();
 
-    for (u32 i_mtl = 0; i_mtl < mtl_count; i_mtl++) {
-        objsubdata_t* curr_sub = &obj_asset.subs[i_mtl];
-        mesh_t* p_curr_mesh = &(p_meshes[i_mtl]);
+    double best_parse_time = 1e9;
+    for (u32 run = 0; run < OBJ_BENCH_RUNS; run++) {
+        arena_reset(&mesh_arena);
+        double start_time = glfwGetTime();
+        read_obj_file(filename, &meshes, &mesh_count, &mesh_arena);
+        best_parse_time = fmin(best_parse_time, glfwGetTime() - start_time);
+    }
+    double parse_peak = get_peak_working_set_mb();
+    write_mesh_cache(filename, meshes, mesh_count);
 
-        u32 mtl_vertex_count = curr_sub->face_count * 3; // Each face is a triangle
-        p_curr_mesh->vertex_count = mtl_vertex_count;
-        p_curr_mesh->vertex_data = malloc(mtl_vertex_count * 8 * sizeof(float));
+    double best_cache_time = 1e9;
+    bool cached = true;
+    for (u32 run = 0; run < OBJ_BENCH_RUNS && cached; run++) {
+        arena_reset(&mesh_arena);
+        filemap_t cache_map = { 0 };
+        double start_time = glfwGetTime();
+        cached = read_mesh_cache(filename, &meshes, &mesh_count, &cache_map, &mesh_arena);
+        best_cache_time = fmin(best_cache_time, glfwGetTime() - start_time);
+        unmap_file(&cache_map);
+    }
 
-        mtldata_t* p_face_mat = NULL;
-        for (u32 i = 0; i < mtl_asset.mtl_count; i++) {
-            if (strcmp(mtl_asset.materials[i].name, curr_sub->mtl_name) == 0) {
-                p_face_mat = &(mtl_asset.materials[i]);
-                break;
-            }
+    printf("load %s, best of %u:\n", filename, OBJ_BENCH_RUNS);
+    printf("  streamed   %8.2f ms, peak working set %.1f MB (%.1f MB before), once\n", stream_time * 1000.0, stream_peak, start_peak);
+    printf("  parse      %8.2f ms, peak working set %.1f MB\n", best_parse_time * 1000.0, parse_peak);
+    if (cached) printf("  mesh cache %8.2f ms, peak working set %.1f MB\n", best_cache_time * 1000.0, get_peak_working_set_mb());
+    else printf("  mesh cache not written\n");
+    arena_destroy(&mesh_arena);
+}
+
+void bench_parse_float(void) {
+    // Times parse_float against strtof on OBJ-looking numbers, and checks they agree on every one
+    arena_t* scratch = get_scratch_arena(0);
+    u64 scratch_mark = arena_mark(scratch);
+    char* text = arena_push(scratch, PARSE_BENCH_FLOAT_COUNT * 24);
+    float* results = arena_push(scratch, PARSE_BENCH_FLOAT_COUNT * sizeof(float));
+    char* c = text;
+    u32 random = 12345;
+    for (u32 i = 0; i < PARSE_BENCH_FLOAT_COUNT; i++) {
+        random = random * 1664525 + 1013904223;
+        float value = ((float)(random >> 8) / (float)(1 << 24) - 0.5f) * 200.0f;
+        c += sprintf(c, (i % 4 == 3) ? "%.9g " : "%.6f ", value); // Most exporters write fixed digits, some write them all
+    }
+    char* end = c;
+
+    double best_times[2] = { 1e9, 1e9 };
+    u32 mismatch_count = 0;
+    for (u32 run = 0; run < OBJ_BENCH_RUNS; run++) {
+        double start_time = glfwGetTime();
+        c = text;
+        for (u32 i = 0; i < PARSE_BENCH_FLOAT_COUNT; i++) {
+            c = parse_skip_spaces(c, end);
+            c = parse_float(c, end, &results[i]);
+        }
+        best_times[0] = fmin(best_times[0], glfwGetTime() - start_time);
+
+        start_time = glfwGetTime();
+        c = text;
+        mismatch_count = 0;
+        for (u32 i = 0; i < PARSE_BENCH_FLOAT_COUNT; i++) {
+            float value = strtof(c, &c);
+            mismatch_count += (memcmp(&value, &results[i], sizeof(float)) != 0);
         }
-        assert(p_face_mat);
+        best_times[1] = fmin(best_times[1], glfwGetTime() - start_time);
+    }
+
+    printf("float parsing, %u numbers, best of %u:\n", PARSE_BENCH_FLOAT_COUNT, OBJ_BENCH_RUNS);
+    printf("  parse_float %6.1f M/s\n", PARSE_BENCH_FLOAT_COUNT / best_times[0] / 1e6);
+    printf("  strtof      %6.1f M/s\n", PARSE_BENCH_FLOAT_COUNT / best_times[1] / 1e6);
+    printf("  %u results differ from strtof\n", mismatch_count);
+    arena_pop_to(scratch, scratch_mark);
+}
 
-        append_prefix(p_face_mat->texture_name, "textures/", MTL_TEXTURE_FILENAME_LEN, p_curr_mesh->texture_name);
+bool parse_float_matches_strtof(char* text, u32* p_mismatch_count) {
+    // Same bits and the same length as strtof, for a null-terminated number
+    float expected, value;
+    char* expected_end;
+    expected = strtof(text, &expected_end);
+    char* end = text + strlen(text);
+    char* value_end = parse_float(text, end, &value);
+    bool matches = memcmp(&expected, &value, sizeof(float)) == 0 && value_end == expected_end;
+    if (!matches && *p_mismatch_count < 8) printf("  %s: %.9g from parse_float, %.9g from strtof\n", text, value, expected);
+    *p_mismatch_count += !matches;
+    return matches;
+}
 
-        u32 i_vertex_data = 0;
-        for (u32 i_face = 0; i_face < curr_sub->face_count; i_face++) {
+bool check_parse_float(void) {
+    // parse_float against strtof. Exact halfway points between two floats (ties go to even,
+    // and the longest ones only fit on the heap), the same cut to fewer digits, random
+    // digit strings with any exponent, and a few edges written out
+    static char* edge_cases[] = {
+        "0", "-0", "0.0e0", "1e4294967296", "-1e-99999999999", "1e-2147483648", "00000000000000000000000000001",
+        "3.4028235e38", "3.4028236e38", "340282356779733661637539395458142568447", "340282356779733661637539395458142568448",
+        "1.17549435e-38", "1.1754942e-38", "1.401298464324817e-45", "7.006492321624085e-46", "7.0064923216240861e-46",
+        "16777217", "16777219", "0.1", "8388608.5", "9999999999999999999", "99999999999999999999e-20",
+    };
+    u32 mismatch_counts[4] = { 0 };
+    char text[256];
+    for (u32 i = 0; i < sizeof(edge_cases) / sizeof(edge_cases[0]); i++) {
+        parse_float_matches_strtof(edge_cases[i], &mismatch_counts[0]);
+    }
+
+    u32 random = 12345;
+    for (u32 i = 0; i < PARSE_CHECK_FLOAT_COUNT; i++) {
+        // Any finite float, the midpoint to the next one up is exact in a double
+        u32 bits;
+        do {
+            random = random * 1664525 + 1013904223;
+            bits = random & 0x7FFFFFFF;
+        } while (bits >= 0x7F7FFFFF);
+        float low, high;
+        u32 high_bits = bits + 1;
+        memcpy(&low, &bits, sizeof(float));
+        memcpy(&high, &high_bits, sizeof(float));
+        double halfway = ((double)low + (double)high) * 0.5;
+        sprintf(text, "%.150e", halfway);
+        parse_float_matches_strtof(text, &mismatch_counts[1]);
+        sprintf(text, "%.*e", 8 + i % 24, halfway);
+        parse_float_matches_strtof(text, &mismatch_counts[2]);
+    }
 
-            // Single triangle (face data is 1-based, hence the "- 1")
+    for (u32 i = 0; i < PARSE_CHECK_FLOAT_COUNT; i++) {
+        // [sign] digits [. digits] [e [sign] digits], runs of the same digit are likely
+        char* c = text;
+        random = random * 1664525 + 1013904223;
+        if (random % 4 == 0) *c++ = (random & 16) ? '-' : '+';
+        u32 integer_count = (random >> 8) % 25;
+        u32 fraction_count = (random >> 16) % 25;
+        bool has_point = (random >> 24) & 1;
+        if (integer_count == 0 && (!has_point || fraction_count == 0)) integer_count = 1;
+        char digit = '0';
+        for (u32 j = 0; j < integer_count + (has_point ? fraction_count + 1 : 0); j++) {
+            if (has_point && j == integer_count) { *c++ = '.'; continue; }
+            random = random * 1664525 + 1013904223;
+            if ((random >> 28) >= 4) digit = (char)('0' + (random >> 8) % 10);
+            *c++ = digit;
+        }
+        random = random * 1664525 + 1013904223;
+        if (random % 2 == 0) {
+            *c++ = (random & 2) ? 'e' : 'E';
+            if (random & 4) *c++ = (random & 8) ? '-' : '+';
+            u32 exponent_digit_count = ((random >> 8) % 32 == 0) ? 12 : 1 + (random >> 16) % 2; // Some that saturate
+            for (u32 j = 0; j < exponent_digit_count; j++) {
+                random = random * 1664525 + 1013904223;
+                *c++ = (char)('0' + (random >> 8) % 10);
+            }
+        }
+        *c = 0;
+        parse_float_matches_strtof(text, &mismatch_counts[3]);
+    }
 
-            u32 i_pos0    = curr_sub->face_data[i_face * 9 + 0] - 1;
-            u32 i_uv0     = curr_sub->face_data[i_face * 9 + 1] - 1;
-            u32 i_normal0 = curr_sub->face_data[i_face * 9 + 2] - 1;
+    bool ok = mismatch_counts[0] + mismatch_counts[1] + mismatch_counts[2] + mismatch_counts[3] == 0;
+    printf("parse_float against strtof: %u edge cases, %u differ; %u halfway, %u differ; %u near halfway, %u differ; %u random strings, %u differ: %s\n",
+        (u32)(sizeof(edge_cases) / sizeof(edge_cases[0])), mismatch_counts[0], PARSE_CHECK_FLOAT_COUNT, mismatch_counts[1],
+        PARSE_CHECK_FLOAT_COUNT, mismatch_counts[2], PARSE_CHECK_FLOAT_COUNT, mismatch_counts[3], ok ? "ok" : "FAILED");
+    return ok;
+}
 
-            u32 i_pos1    = curr_sub->face_data[i_face * 9 + 3] - 1;
-            u32 i_uv1     = curr_sub->face_data[i_face * 9 + 4] - 1;
-            u32 i_normal1 = curr_sub->face_data[i_face * 9 + 5] - 1;
+bool check_obj_usemtl_groups(void) {
+    // Many short runs of faces switching between a few materials. Every face
+    // points at its own number through its position index, so each group has to
+    // come out with exactly the faces of its material, in file order
+    arena_t* scratch = get_scratch_arena(0);
+    u64 scratch_mark = arena_mark(scratch);
+    char* text = arena_push(scratch, OBJ_CHECK_SWITCH_COUNT * (24 + 8 * 40));
+    u32 expected_counts[OBJ_CHECK_MTL_COUNT] = { 0 };
+    char* c = text;
+    u32 random = 12345;
+    u32 face_count = 0;
+    for (u32 i_switch = 0; i_switch < OBJ_CHECK_SWITCH_COUNT; i_switch++) {
+        random = random * 1664525 + 1013904223;
+        u32 i_mtl = (random >> 8) % OBJ_CHECK_MTL_COUNT;
+        u32 run_length = (random >> 20) % 8; // Some switches have no faces at all
+        c += sprintf(c, "usemtl mtl%u\n", i_mtl);
+        for (u32 i = 0; i < run_length; i++) {
+            c += sprintf(c, "f %u/1/1 %u/1/1 %u/1/1\n", face_count + 1, face_count + 1, face_count + 1);
+            face_count++;
+        }
+        expected_counts[i_mtl] += run_length;
+    }
+    char* end = c;
 
-            u32 i_pos2    = curr_sub->face_data[i_face * 9 + 6] - 1;
-            u32 i_uv2     = curr_sub->face_data[i_face * 9 + 7] - 1;
-            u32 i_normal2 = curr_sub->face_data[i_face * 9 + 8] - 1;
+    objasset_t obj_asset = { 0 };
+    obj_asset.i_curr_mtl = -1;
+    obj_asset.arena = scratch;
+    obj_parse_range(&obj_asset, text, end);
 
-            // Vertex data format: v,v,v, u,u, n,n,n
+    // Walk the text again, and follow each face into its group
+    bool ok = obj_asset.mtl_count == OBJ_CHECK_MTL_COUNT;
+    u32 next_faces[OBJ_CHECK_MTL_COUNT] = { 0 };
+    random = 12345;
+    face_count = 0;
+    for (u32 i_switch = 0; ok && i_switch < OBJ_CHECK_SWITCH_COUNT; i_switch++) {
+        random = random * 1664525 + 1013904223;
+        u32 i_mtl = (random >> 8) % OBJ_CHECK_MTL_COUNT;
+        u32 run_length = (random >> 20) % 8;
+        char mtl_name[MTL_NAME_LEN];
+        sprintf(mtl_name, "mtl%u", i_mtl);
+        i32 i_sub = obj_find_or_add_sub(&obj_asset, mtl_name);
+        objsubdata_t* sub = &obj_asset.subs[i_sub];
+        ok = (sub->face_count == expected_counts[i_mtl]);
+        for (u32 i = 0; ok && i < run_length; i++) {
+            ok = (sub->face_data[next_faces[i_mtl]++ * 9] == face_count++);
+        }
+    }
 
-            // 1st vertex
-            p_curr_mesh->vertex_data[i_vertex_data++] = obj_asset.positions[i_pos0 * 3 + 0];
-            p_curr_mesh->vertex_data[i_vertex_data++] = obj_asset.positions[i_pos0 * 3 + 1];
-            p_curr_mesh->vertex_data[i_vertex_data++] = obj_asset.positions[i_pos0 * 3 + 2];
-            p_curr_mesh->vertex_data[i_vertex_data++] = obj_asset.uvs[i_uv0 * 2 + 0];
-            p_curr_mesh->vertex_data[i_vertex_data++] = obj_asset.uvs[i_uv0 * 2 + 1];
-            p_curr_mesh->vertex_data[i_vertex_data++] = obj_asset.normals[i_normal0 * 3 + 0];
-            p_curr_mesh->vertex_data[i_vertex_data++] = obj_asset.normals[i_normal0 * 3 + 1];
-            p_curr_mesh->vertex_data[i_vertex_data++] = obj_asset.normals[i_normal0 * 3 + 2];
+    printf("usemtl groups, %u switches between %u materials, %u faces: %s\n", OBJ_CHECK_SWITCH_COUNT, OBJ_CHECK_MTL_COUNT, face_count, ok ? "ok" : "FAILED");
+    arena_pop_to(scratch, scratch_mark);
+    return ok;
+}
 
-            // 2nd vertex
-            p_curr_mesh->vertex_data[i_vertex_data++] = obj_asset.positions[i_pos1 * 3 + 0];
-            p_curr_mesh->vertex_data[i_vertex_data++] = obj_asset.positions[i_pos1 * 3 + 1];
-            p_curr_mesh->vertex_data[i_vertex_data++] = obj_asset.positions[i_pos1 * 3 + 2];
-            p_curr_mesh->vertex_data[i_vertex_data++] = obj_asset.uvs[i_uv1 * 2 + 0];
-            p_curr_mesh->vertex_data[i_vertex_data++] = obj_asset.uvs[i_uv1 * 2 + 1];
-            p_curr_mesh->vertex_data[i_vertex_data++] = obj_asset.normals[i_normal1 * 3 + 0];
-            p_curr_mesh->vertex_data[i_vertex_data++] = obj_asset.normals[i_normal1 * 3 + 1];
-            p_curr_mesh->vertex_data[i_vertex_data++] = obj_asset.normals[i_normal1 * 3 + 2];
+bool obj_assets_identical(objasset_t* a, objasset_t* b) {
+    if (a->position_count != b->position_count || a->uv_count != b->uv_count || a->normal_count != b->normal_count) return false;
+    if (a->mtl_count != b->mtl_count || strcmp(a->mtllib_name, b->mtllib_name) != 0) return false;
+    if (memcmp(a->positions, b->positions, a->position_count * 3 * sizeof(float)) != 0) return false;
+    if (memcmp(a->uvs, b->uvs, a->uv_count * 2 * sizeof(float)) != 0) return false;
+    if (memcmp(a->normals, b->normals, a->normal_count * 3 * sizeof(float)) != 0) return false;
+    for (u32 i = 0; i < a->mtl_count; i++) {
+        if (strcmp(a->subs[i].mtl_name, b->subs[i].mtl_name) != 0 || a->subs[i].face_count != b->subs[i].face_count) return false;
+        if (memcmp(a->subs[i].face_data, b->subs[i].face_data, a->subs[i].face_count * 9 * sizeof(u32)) != 0) return false;
+    }
+    return true;
+}
 
-            // 3rd vertex
-            p_curr_mesh->vertex_data[i_vertex_data++] = obj_asset.positions[i_pos2 * 3 + 0];
-            p_curr_mesh->vertex_data[i_vertex_data++] = obj_asset.positions[i_pos2 * 3 + 1];
-            p_curr_mesh->vertex_data[i_vertex_data++] = obj_asset.positions[i_pos2 * 3 + 2];
-            p_curr_mesh->vertex_data[i_vertex_data++] = obj_asset.uvs[i_uv2 * 2 + 0];
-            p_curr_mesh->vertex_data[i_vertex_data++] = obj_asset.uvs[i_uv2 * 2 + 1];
-            p_curr_mesh->vertex_data[i_vertex_data++] = obj_asset.normals[i_normal2 * 3 + 0];
-            p_curr_mesh->vertex_data[i_vertex_data++] = obj_asset.normals[i_normal2 * 3 + 1];
-            p_curr_mesh->vertex_data[i_vertex_data++] = obj_asset.normals[i_normal2 * 3 + 2];
-            
+bool check_obj_parallel_parse(void) {
+    // The parallel parse has to give exactly what the serial one gives, at any
+    // thread count. The generated file has every face corner form, negative
+    // indices, polygons and material switches landing anywhere in the chunks
+    arena_t* scratch = get_scratch_arena(0);
+    u64 scratch_mark = arena_mark(scratch);
+    char* text = arena_push(scratch, OBJ_CHECK_PARALLEL_BLOCKS * 256);
+    char* c = text;
+    c += sprintf(c, "mtllib check.mtl\n");
+    u32 random = 12345;
+    for (u32 i = 0; i < OBJ_CHECK_PARALLEL_BLOCKS; i++) {
+        u32 n = i * 4; // Attributes before this block
+        random = random * 1664525 + 1013904223;
+        float value = ((float)(random >> 8) / (float)(1 << 24) - 0.5f) * 200.0f;
+        c += sprintf(c, "v %.6f %.6f %.6f\nv 1 %u 0\nv 0 1 %.9g\nv 1 1 1\n", value, value * 0.5f, -value, i, value);
+        c += sprintf(c, "vt %.6f 0.5\nvt 0 1\nvt 1 0\nvt 1 1\nvn 0 0 1\nvn 0 1 0\nvn 1 0 0\nvn %.6f 0 1\n", value, value);
+        if ((random >> 24) % 4 == 0) c += sprintf(c, "usemtl mtl%u\n", (random >> 16) % OBJ_CHECK_MTL_COUNT);
+        switch ((random >> 12) % 5) {
+            case 0: c += sprintf(c, "f %u/%u/%u %u/%u/%u %u/%u/%u\n", n + 1, n + 1, n + 1, n + 2, n + 2, n + 2, n + 3, n + 3, n + 3); break;
+            case 1: c += sprintf(c, "f -1/-1/-1 -2/-2/-2 -3/-3/-3 -4/-4/-4\n"); break;
+            case 2: c += sprintf(c, "f %u//%u %u//%u %u//%u\n", n + 1, n + 4, n + 2, n + 4, n + 4, n + 4); break;
+            case 3: c += sprintf(c, "f %u %u %u %u %u\n", n + 1, n + 2, n + 3, n + 4, n + 1); break;
+            default: c += sprintf(c, "# comment\ng group\ns off\nf %u/%u -2/-2 -1/-1\n", n + 1, n + 1); break;
         }
     }
+    char* end = c;
 
+    objasset_t serial = { 0 };
+    serial.i_curr_mtl = -1;
+    serial.arena = scratch;
+    obj_parse_range(&serial, text, end);
 
-    free(obj_file_content);
-    free(obj_asset.positions);
-    free(obj_asset.uvs);
-    free(obj_asset.normals);
-    for (u32 i = 0; i < obj_asset.mtl_count; i++) {
-        free(obj_asset.subs[i].face_data);
+    SYSTEM_INFO system_info;
+    GetSystemInfo(&system_info);
+    u32 thread_counts[] = { 1, 2, 4, (system_info.dwNumberOfProcessors < OBJ_PARSE_MAX_THREADS) ? system_info.dwNumberOfProcessors : OBJ_PARSE_MAX_THREADS };
+    bool ok = true;
+    for (u32 i = 0; i < sizeof(thread_counts) / sizeof(thread_counts[0]); i++) {
+        u64 parallel_mark = arena_mark(scratch);
+        objasset_t parallel = { 0 };
+        parallel.arena = scratch;
+        obj_parse_parallel(&parallel, text, end, thread_counts[i]);
+        bool identical = obj_assets_identical(&serial, &parallel);
+        printf("parallel parse, %u threads, %.1f MB: %s\n", thread_counts[i], (double)(end - text) / (1024.0 * 1024.0), identical ? "identical" : "DIFFERENT");
+        ok = ok && identical;
+        arena_pop_to(scratch, parallel_mark);
     }
-    free(obj_asset.subs);
+
+    arena_pop_to(scratch, scratch_mark);
+    reset_scratch_arenas(); // The workers' too
+    return ok;
 }
 
+void obj_stream_count_batch(mesh_t* p_batch, void* user_data) {
+    *(u32*)user_data += p_batch->index_count / 3;
+}
+
+bool check_obj_streaming_memory(void) {
+    // Streams two generated files over the same vertices, one with 4 times the faces
+    // of the other. The scratch memory of a streamed load depends on the window
+    // and batch sizes and the attributes, so both have to peak at the same size
+    char* filenames[2] = { "models/stream_check_1.obj", "models/stream_check_4.obj" };
+    FILE* f = fopen("models/stream_check.mtl", "wb");
+    if (f == NULL) return false;
+    fprintf(f, "newmtl check\nmap_Kd check.png\n");
+    fclose(f);
+
+    u64 high_waters[2] = { 0 };
+    bool ok = true;
+    for (u32 i_file = 0; i_file < 2; i_file++) {
+        u32 face_count = OBJ_CHECK_STREAM_FACES * (i_file == 0 ? 1 : 4);
+        f = fopen(filenames[i_file], "wb");
+        if (f == NULL) return false;
+        fprintf(f, "mtllib stream_check.mtl\n");
+        for (u32 i = 0; i < 1024; i++) {
+            fprintf(f, "v %u %u 0\nvt 0 0\nvn 0 0 1\n", i % 32, i / 32);
+        }
+        fprintf(f, "usemtl check\n");
+        u32 random = 12345;
+        for (u32 i = 0; i < face_count; i++) {
+            random = random * 1664525 + 1013904223;
+            u32 i_vertex = (random >> 8) % 990 + 1;
+            fprintf(f, "f %u/1/1 %u/1/1 %u/1/1\n", i_vertex, i_vertex + 1, i_vertex + 32);
+        }
+        fclose(f);
+
+        reset_scratch_arenas();
+        for (u32 i = 0; i <= 1; i++) get_scratch_arena(i)->high_water = 0;
+        u32 streamed_face_count = 0;
+        read_obj_file_streaming(filenames[i_file], OBJ_CHECK_STREAM_WINDOW_SIZE, OBJ_CHECK_STREAM_BATCH_FACES, obj_stream_count_batch, &streamed_face_count);
+        high_waters[i_file] = get_scratch_arena(0)->high_water + get_scratch_arena(1)->high_water;
+        ok = ok && streamed_face_count == face_count;
+        DeleteFileA(filenames[i_file]);
+    }
+    DeleteFileA("models/stream_check.mtl");
+
+    ok = ok && high_waters[1] <= high_waters[0] + high_waters[0] / 10;
+    printf("streaming, %u and %u faces: scratch high water %.2f and %.2f MB: %s\n", OBJ_CHECK_STREAM_FACES, OBJ_CHECK_STREAM_FACES * 4, 
+            (double)high_waters[0] / (1024.0 * 1024.0), (double)high_waters[1] / (1024.0 * 1024.0), ok ? "ok" : "FAILED");
+    return ok;
+}
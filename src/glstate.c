@@ -0,0 +1,81 @@
+// Shadow of the GL state the renderer changes. Calls that wouldn't change anything are
+// skipped, so callers can bind what they need without knowing what's bound. Everything
+// that changes this state has to go through here, or the shadow goes stale
+
+glstate_t gl_state;
+
+void gl_state_init(void) {
+    // GL's defaults, right after context creation
+    memset(&gl_state, 0, sizeof(gl_state));
+    gl_state.blend_func = (GL_ONE << 16) | GL_ZERO;
+    gl_state.cull_mode = GL_BACK;
+}
+
+bool gl_state_update(u32* p_shadow, u32 value) {
+    // True if the value changes. Counts the call as issued or skipped
+    bool changed = (*p_shadow != value);
+    *p_shadow = value;
+    if (changed || !GL_STATE_CACHE) gl_state.issued_count++;
+    else gl_state.skipped_count++;
+    return changed;
+}
+
+bool gl_state_use_program(u32 program) {
+    bool changed = gl_state_update(&gl_state.program, program);
+    if (changed || !GL_STATE_CACHE) glUseProgram(program);
+    return changed;
+}
+
+bool gl_state_bind_vao(u32 vao) {
+    bool changed = gl_state_update(&gl_state.vao, vao);
+    if (changed || !GL_STATE_CACHE) glBindVertexArray(vao);
+    return changed;
+}
+
+void gl_state_active_texture(u32 unit) {
+    assert(unit < GL_STATE_TEXTURE_UNITS);
+    if (gl_state_update(&gl_state.active_unit, unit) || !GL_STATE_CACHE) glActiveTexture(GL_TEXTURE0 + unit);
+}
+
+bool gl_state_bind_texture(u32 unit, u32 target, u32 texture) {
+    // Switches the active unit only when the bind goes through
+    assert(unit < GL_STATE_TEXTURE_UNITS && (target == GL_TEXTURE_2D || target == GL_TEXTURE_2D_ARRAY));
+    bool changed = gl_state_update(&gl_state.textures[unit][(target == GL_TEXTURE_2D_ARRAY) ? 1 : 0], texture);
+    if (changed || !GL_STATE_CACHE) {
+        gl_state_active_texture(unit);
+        glBindTexture(target, texture);
+    }
+    return changed;
+}
+
+void gl_state_set_enabled(u32 capability, bool enabled) {
+    u32 bit = (capability == GL_BLEND) ? GL_STATE_BLEND : (capability == GL_DEPTH_TEST) ? GL_STATE_DEPTH_TEST : GL_STATE_CULL_FACE;
+    assert(capability == GL_BLEND || capability == GL_DEPTH_TEST || capability == GL_CULL_FACE);
+    u32 flags = enabled ? (gl_state.enabled_flags | bit) : (gl_state.enabled_flags & ~bit);
+    if (gl_state_update(&gl_state.enabled_flags, flags) || !GL_STATE_CACHE) {
+        if (enabled) glEnable(capability);
+        else glDisable(capability);
+    }
+}
+
+void gl_state_blend_func(u32 src_factor, u32 dst_factor) {
+    if (gl_state_update(&gl_state.blend_func, (src_factor << 16) | dst_factor) || !GL_STATE_CACHE) glBlendFunc(src_factor, dst_factor);
+}
+
+void gl_state_cull_face(u32 mode) {
+    if (gl_state_update(&gl_state.cull_mode, mode) || !GL_STATE_CACHE) glCullFace(mode);
+}
+
+void gl_state_delete_texture(u32* p_texture) {
+    // GL unbinds deleted textures, and can hand the name out again
+    for (u32 i = 0; i < GL_STATE_TEXTURE_UNITS; i++) {
+        if (gl_state.textures[i][0] == *p_texture) gl_state.textures[i][0] = 0;
+        if (gl_state.textures[i][1] == *p_texture) gl_state.textures[i][1] = 0;
+    }
+    glDeleteTextures(1, p_texture);
+}
+
+void gl_state_delete_vao(u32* p_vao) {
+    if (gl_state.vao == *p_vao) gl_state.vao = 0;
+    glDeleteVertexArrays(1, p_vao);
+}
@@ -0,0 +1,166 @@
+// LZ4-style block codec for the pack. A block is a run of sequences:
+//   token: literal count << 4 | (match length - LZ_MIN_MATCH), 15 means more length bytes follow
+//   [literal length bytes] literals offset(u16 little endian) [match length bytes]
+// Extra length bytes are added up, a byte below 255 ends them. The last
+// sequence is literals only. Blocks don't refer to each other, so they can be
+// decompressed in any order
+
+#define LZ_MIN_MATCH 4
+#define LZ_MAX_OFFSET 65535
+#define LZ_HASH_BITS 14
+#define LZ_LAST_LITERALS 5 // A match never reaches into the last bytes of a block
+#define LZ_MATCH_LIMIT 12 // And doesn't start this close to the end
+#define LZ_WILDCOPY 16 // Decompression copies in chunks of this much when there's room
+
+u64 lz_compress_bound(u64 size) {
+    // Worst case, everything is literals
+    return size + size / 255 + 16;
+}
+
+u8* lz_write_length(u8* op, u64 length) {
+    // The part that didn't fit in the token's nibble
+    while (length >= 255) {
+        *op++ = 255;
+        length -= 255;
+    }
+    *op++ = (u8)length;
+    return op;
+}
+
+u32 lz_read32(u8* p) {
+    u32 value;
+    memcpy(&value, p, sizeof(u32));
+    return value;
+}
+
+u64 lz_compress(u8* src, u64 src_size, u8* dst, u64 dst_capacity) {
+    // Greedy, one candidate per hash. Returns the compressed size, or 0 if it doesn't fit in dst
+    u32 hash_table[1 << LZ_HASH_BITS] = { 0 }; // Positions in src
+    u8* ip = src;
+    u8* anchor = src; // Start of the pending literals
+    u8* src_end = src + src_size;
+    u8* op = dst;
+    u8* dst_end = dst + dst_capacity;
+
+    if (src_size > LZ_MATCH_LIMIT) {
+        u8* match_start_limit = src_end - LZ_MATCH_LIMIT;
+        u8* match_end_limit = src_end - LZ_LAST_LITERALS;
+        while (ip < match_start_limit) {
+            u32 sequence = lz_read32(ip);
+            u32 hash = (sequence * 2654435761u) >> (32 - LZ_HASH_BITS);
+            u8* candidate = src + hash_table[hash];
+            hash_table[hash] = (u32)(ip - src);
+            if (candidate >= ip || ip - candidate > LZ_MAX_OFFSET || lz_read32(candidate) != sequence) {
+                ip++;
+                continue;
+            }
+
+            u8* match_end = ip + LZ_MIN_MATCH;
+            u8* c = candidate + LZ_MIN_MATCH;
+            while (match_end < match_end_limit && *match_end == *c) {
+                match_end++;
+                c++;
+            }
+
+            u64 literal_count = (u64)(ip - anchor);
+            u64 match_length = (u64)(match_end - ip) - LZ_MIN_MATCH;
+            u64 worst_size = 1 + literal_count / 255 + 1 + literal_count + 2 + match_length / 255 + 1;
+            if (worst_size > (u64)(dst_end - op)) return 0;
+
+            u8* p_token = op++;
+            *p_token = (u8)(((literal_count < 15) ? literal_count : 15) << 4);
+            if (literal_count >= 15) op = lz_write_length(op, literal_count - 15);
+            memcpy(op, anchor, literal_count);
+            op += literal_count;
+            u16 offset = (u16)(ip - candidate);
+            op[0] = (u8)offset;
+            op[1] = (u8)(offset >> 8);
+            op += 2;
+            *p_token |= (u8)((match_length < 15) ? match_length : 15);
+            if (match_length >= 15) op = lz_write_length(op, match_length - 15);
+
+            ip = match_end;
+            anchor = ip;
+        }
+    }
+
+    u64 literal_count = (u64)(src_end - anchor);
+    if (1 + literal_count / 255 + 1 + literal_count > (u64)(dst_end - op)) return 0;
+    *op++ = (u8)(((literal_count < 15) ? literal_count : 15) << 4);
+    if (literal_count >= 15) op = lz_write_length(op, literal_count - 15);
+    memcpy(op, anchor, literal_count);
+    op += literal_count;
+    return (u64)(op - dst);
+}
+
+void lz_wildcopy(u8* dst, u8* src, u64 size) {
+    // Fixed size copies, can write up to LZ_WILDCOPY - 1 bytes past dst + size
+    for (u64 i = 0; i < size; i += LZ_WILDCOPY) {
+        memcpy(dst + i, src + i, LZ_WILDCOPY);
+    }
+}
+
+u64 lz_decompress(u8* src, u64 src_size, u8* dst, u64 dst_size) {
+    // Returns the decompressed size, 0 if the block is malformed. Never writes past dst_size
+    u8* ip = src;
+    u8* src_end = src + src_size;
+    u8* op = dst;
+    u8* dst_end = dst + dst_size;
+    while (ip < src_end) {
+        u8 token = *ip++;
+
+        u64 literal_count = token >> 4;
+        if (literal_count == 15) {
+            u8 b;
+            do {
+                if (ip >= src_end) return 0;
+                b = *ip++;
+                literal_count += b;
+            } while (b == 255);
+        }
+        if (literal_count > (u64)(src_end - ip) || literal_count > (u64)(dst_end - op)) return 0;
+        if (literal_count + LZ_WILDCOPY <= (u64)(src_end - ip) && literal_count + LZ_WILDCOPY <= (u64)(dst_end - op)) {
+            lz_wildcopy(op, ip, literal_count);
+        } else {
+            memcpy(op, ip, literal_count);
+        }
+        op += literal_count;
+        ip += literal_count;
+        if (ip == src_end) break; // Last sequence
+
+        if (src_end - ip < 2) return 0;
+        u64 offset = (u64)ip[0] | ((u64)ip[1] << 8);
+        ip += 2;
+        if (offset == 0 || offset > (u64)(op - dst)) return 0;
+
+        u64 match_length = token & 15;
+        if (match_length == 15) {
+            u8 b;
+            do {
+                if (ip >= src_end) return 0;
+                b = *ip++;
+                match_length += b;
+            } while (b == 255);
+        }
+        match_length += LZ_MIN_MATCH;
+        if (match_length > (u64)(dst_end - op)) return 0;
+
+        u8* match = op - offset;
+        if (offset >= LZ_WILDCOPY && match_length + LZ_WILDCOPY <= (u64)(dst_end - op)) {
+            lz_wildcopy(op, match, match_length);
+            op += match_length;
+            continue;
+        }
+
+        // The match can overlap what it's writing (a run). What's been copied
+        // repeats with a period of "offset", so the copies double in size
+        for (u64 copied = 0; copied < match_length;) {
+            u64 n = match_length - copied;
+            if (n > copied + offset) n = copied + offset;
+            memcpy(op + copied, match, n);
+            copied += n;
+        }
+        op += match_length;
+    }
+    return (u64)(op - dst);
+}
@@ -1,5 +1,4 @@
 // - start from here: 
-// - [assets] handle comments correctly when computing mtl_count
 // - [infra] move_dir pdb file to bin and make sure remedybg/raddbg works
 // - [infra] be able to click exe. get rid of path errors
 // - [infra] figure out sensitivity difference between machines
@@ -16,20 +15,43 @@
 #include <stdlib.h>
 #include <assert.h>
 #include <math.h>
+#include <float.h>
+#include <emmintrin.h> // SSE2, for the texture baker
+
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#include <psapi.h>
+
+// Every call through GLEW's function pointers is counted, the GL 1.1 ones the frame
+// uses are wrapped below. Reported per frame, to keep an eye on driver overhead
+static uint32_t gl_call_count = 0;
+#define GLEW_GET_FUN(x) (gl_call_count++, x)
 
 #define GLEW_STATIC // Also need to include opengl32lib for this to work
 #include <GL/glew.h>
 #include <glfw3.h>
 
+#define glClear(...) (gl_call_count++, glClear(__VA_ARGS__))
+#define glClearColor(...) (gl_call_count++, glClearColor(__VA_ARGS__))
+#define glBindTexture(...) (gl_call_count++, glBindTexture(__VA_ARGS__))
+#define glDrawArrays(...) (gl_call_count++, glDrawArrays(__VA_ARGS__))
+#define glDrawElements(...) (gl_call_count++, glDrawElements(__VA_ARGS__))
+
 #define STB_IMAGE_IMPLEMENTATION
 #include <stb_image.h>
 #define STB_TRUETYPE_IMPLEMENTATION 
 #include <stb_truetype.h>
 #pragma warning(pop)
 
+// windows.h leaks these, they're used as parameter names
+#undef near
+#undef far
+
 typedef size_t u64;
 typedef uint32_t u32;
 typedef int32_t i32;
+typedef int16_t i16;
+typedef uint16_t u16;
 typedef uint8_t u8;
 
 #define DEG2RAD 0.0174533f
@@ -43,23 +65,270 @@ typedef uint8_t u8;
 #define MTL_NAME_LEN 32 // name of sections inside a .mtl file
 #define MTL_FILENAME_LEN 64 // .mtl file itself
 #define MTL_TEXTURE_FILENAME_LEN 64
+#define VERTEX_CACHE_SIZE 16 // Post-transform cache entries the mesh optimizer targets
+#define MESH_VERTEX_SIZE (8 * sizeof(float)) // Position, uv, normal
+#define MESH_COMPACT_VERTEX_SIZE 14 // Quantized, see meshopt.c
+#define MESH_MAX_LODS 4 // The full mesh included
+#define MESH_LOD_MIN_TRIANGLES 64 // Smaller meshes don't get LODs
+#define MESH_LOD_BORDER_WEIGHT 10.0f // Keeps open borders from moving while simplifying
+#define LOD_MAX_PIXEL_ERROR 1.0f // Coarsest level whose error projects under this many pixels is drawn
+#define LOD_HYSTERESIS 0.75f // A coarser level has to be this far under the limit to switch to it
+#define LOD_BENCH_COLUMNS 8
+#define LOD_BENCH_ROWS 64
+#define LOD_BENCH_WARMUP_FRAMES 10
+#define LOD_BENCH_FRAMES 100
+#define INSTANCE_BENCH_COUNT 100000
+#define INSTANCE_BENCH_SIDE 50 // Cubes per row and column of a layer, layers go away from the camera
+#define INSTANCE_BENCH_SPACING 2.0f
+#define INSTANCE_BENCH_DRAW_COUNT 2048 // Cubes drawn one by one to compare, the uniform ring can't hold many more draws
+#define INSTANCE_BENCH_WARMUP_FRAMES 10
+#define INSTANCE_BENCH_FRAMES 100
+#define MULTI_DRAW_BENCH_MAX_OBJECTS 100000 // Objects go up by 100x from 10 to this
+#define MULTI_DRAW_BENCH_RING_FRAME_SIZE (32 * 1024 * 1024) // Holds MULTI_DRAW_BENCH_MAX_OBJECTS draws with their own uniforms
+#define MULTI_DRAW_BENCH_WARMUP_FRAMES 10
+#define MULTI_DRAW_BENCH_FRAMES 100
+#define MESHLET_MAX_VERTICES 64
+#define MESHLET_MAX_TRIANGLES 124
+#define MESH_MESHLET_MIN_TRIANGLES 512 // Smaller meshes are drawn whole, culling their clusters costs more than it saves
+#ifndef GL_STATE_CACHE
+#define GL_STATE_CACHE 1 // 0 issues every state call, to measure what the cache saves
+#endif
+#define GL_STATE_TEXTURE_UNITS 4
+#define GL_STATE_BLEND 1
+#define GL_STATE_DEPTH_TEST 2
+#define GL_STATE_CULL_FACE 4
+#define UNIFORM_BINDING_CAMERA 0 // camera_block, see shader_world_vert.glsl
+#define UNIFORM_BINDING_OBJECT 1 // object_block
+#define RENDER_DRAW_SINGLE 0 // u_layer.y, see shader_world_vert.glsl
+#define RENDER_DRAW_INSTANCED 1
+#define RENDER_DRAW_POOLED 2
+#define GEOMETRY_POOL_DRAW_BINDING 3 // Vertex buffer binding of pooldraw_t, glVertexAttribPointer takes 0 to 2 for the vertices
+#define UNIFORM_RING_FRAMES 3 // The CPU waits if it gets this many frames ahead of the GPU
+#define UNIFORM_RING_FRAME_SIZE (2 * 1024 * 1024) // Of the main loop's ring
+#define RENDER_QUEUE_CAPACITY 16384 // Draw packets per frame, in the main loop
+#define RENDER_PASS_OPAQUE 0
+#define OBJ_PARSE_MAX_THREADS 64
+#define OBJ_INDEX_NONE 0xFFFFFFFF // Face corner without a uv or normal
+#define OBJ_BENCH_RUNS 5
+#define OBJ_CHECK_SWITCH_COUNT 100000 // usemtl lines in the generated file
+#define OBJ_CHECK_MTL_COUNT 8
+#define OBJ_CHECK_PARALLEL_BLOCKS 100000 // Of 4 vertices and a face each, about 20 MB of text
+#define PARSE_BENCH_FLOAT_COUNT (4 * 1024 * 1024)
+#define PARSE_CHECK_FLOAT_COUNT 200000 // Of each kind
+#define OBJ_PARSE_MIN_CHUNK_SIZE (4 * 1024 * 1024) // Smaller files are parsed on a single thread
+#define TEXTURE_CACHE_MAX 64
+#define TEXTURE_DECODE_MAX_THREADS 8
+#define TEXTURE_UPLOADS_PER_FRAME 2 // Spreads the upload cost over a few frames
+#define TEXTURE_FLAG_SRGB 1 // Color data, sampled as linear
+#define ARENA_RESERVE_SIZE (64ull * 1024 * 1024 * 1024) // Address space only
+#define ARENA_COMMIT_SIZE (1024 * 1024)
+#define ARENA_SCRATCH_KEEP_SIZE (16 * 1024 * 1024) // Scratch arenas decommit anything above this when reset
+#define OBJ_STREAM_MIN_FILE_SIZE (256ull * 1024 * 1024) // Larger .obj files are streamed instead of mapped whole
+#define OBJ_STREAM_WINDOW_SIZE (8 * 1024 * 1024)
+#define OBJ_STREAM_BATCH_FACES (64 * 1024)
+#define OBJ_CHECK_STREAM_FACES 100000 // Of the smaller generated file, the other one has 4 times as many
+#define OBJ_CHECK_STREAM_WINDOW_SIZE (256 * 1024)
+#define OBJ_CHECK_STREAM_BATCH_FACES 8192
+#define MESH_CACHE_MAGIC 0x4853454D // "MESH"
+#define MESH_CACHE_VERSION 6 // Meshes are stored optimized, with their LODs, meshlets and texture flags
+#define TEXBAKE_MAGIC 0x58455437 // "7TEX"
+#define TEXBAKE_VERSION 1
+#define TEXBAKE_MAX_MIPS 16
+#define PACK_MAGIC 0x4B503750 // "P7PK"
+#define PACK_VERSION 2
+#define PACK_PATH_LEN 64
+#define PACK_ALIGN 64 // Blobs and the table start on cache lines
+#define PACK_MAX_FILES 1024
+#define PACK_BLOCK_SIZE (256 * 1024) // Compressed entries are split into blocks of this much uncompressed data
+#define PACK_BLOCK_STORED 0x80000000u // Set in a block's size if it's stored as is
+#define PACK_MIN_SAVING 8 // Compressed entries have to be at least 1/8 smaller, or they're stored as is
+#define PACK_DECOMPRESS_MAX_THREADS 16
+#define PACK_DECOMPRESS_MIN_BLOCKS 4 // Smaller entries are decompressed on the calling thread
+
+typedef struct {
+    u32 first_index;
+    u32 index_count;
+    float error; // Furthest the surface moved from the full mesh, in model units
+} meshlod_t;
+
+typedef struct {
+    u32 first_index;
+    u32 triangle_count;
+    u32 vertex_count; // Unique vertices, the vertex shader runs at least this many times
+    float center[3]; // Bounding sphere, in model space
+    float radius;
+    float cone_axis[3]; // Average facing of the triangles
+    float cone_cutoff; // Sine of the normal cone's half angle, 1 if the cone is too wide to cull with
+} meshlet_t; // Cluster of the full mesh's triangles, culled as a whole
+
+typedef struct {
+    u32 vao; // Shared by every mesh in the pool
+    u32 vbo;
+    u32 ebo; // 32 bit indices, rebased onto their mesh's first vertex
+    u32 vertex_size;
+    u32 vertex_capacity;
+    u32 index_capacity;
+    u32 vertex_count; // Allocated so far, from the start
+    u32 index_count;
+} geometrypool_t; // Static meshes in one vertex and index buffer, drawn together with multi draws
 
 typedef struct {
     u32 vao;
     u32 vbo;
-    u32 vertex_count;
-    u32 tex_handle;
+    u32 ebo;
+    u32 index_type; // GL_UNSIGNED_SHORT or GL_UNSIGNED_INT
+    u32 index_size; // In bytes
+    u32 texture_id; // Slot in the texture cache, its GL handle can change while loading
+    float dequant[12]; // u_dequant, see shader_world_vert.glsl
+    u32 lod_count;
+    meshlod_t lods[MESH_MAX_LODS]; // Index ranges in the ebo
+    u32 current_lod; // Picked by render_select_lod, kept between frames for the hysteresis
+    float bounds[4]; // Center and radius in model space
+    meshlet_t* meshlets; // Owned, in the full mesh's index range
+    u32 meshlet_count;
+    u32 instance_buffer; // Drawn instanced if there's one, see render_create_instances
+    u32 instance_count;
+    geometrypool_t* p_pool; // Holds the vertices and indices if set, the VAO is the pool's
 } gameobject_t;
 
+typedef struct {
+    u32 draw_count;
+    u32 multi_draw_command_count; // Ranges drawn by multi draws, a draw each without the geometry pool
+    u32 texture_bind_count;
+    u32 program_switch_count;
+    u32 vao_switch_count;
+    u32 triangle_count;
+    u32 instance_count; // Drawn by instanced draws
+    u32 meshlet_count; // Considered for culling
+    u32 meshlet_culled_count;
+    u32 culled_vertex_count; // Vertex shader runs saved, counting each meshlet's vertices once
+    u32 gl_call_count;
+    u32 uniform_bytes; // Written to the uniform ring
+    u32 state_calls_issued; // Through the GL state cache
+    u32 state_calls_skipped;
+} renderstats_t; // Per frame
+
+typedef struct {
+    float view[16];
+    float proj[16];
+    float view_proj[16];
+    float eye[4];
+} cameradata_t; // camera_block in std140 layout, meshlets are culled against it too
+
+typedef struct {
+    float model[16];
+    float dequant[12]; // u_dequant
+    i32 layer;
+    i32 draw_mode; // RENDER_DRAW_*
+    i32 padding[2];
+} objectdata_t; // object_block in std140 layout
+
+typedef struct {
+    float model[16]; // Placed by the draw's model matrix
+    i32 layer; // In the texture array of the mesh's texture
+} instancedata_t; // Per instance vertex attributes
+
+typedef struct {
+    float model[16];
+    i32 layer;
+    float dequant[12];
+} pooldraw_t; // Per draw vertex attributes of pooled draws, model and layer where instancedata_t has them
+
+typedef struct {
+    u32 count;
+    u32 instance_count;
+    u32 first_index;
+    i32 base_vertex;
+    u32 base_instance; // Picks the draw's pooldraw_t
+} drawcommand_t; // Layout glMultiDrawElementsIndirect reads
+
+typedef struct {
+    u32 buffer;
+    u8* p_mapped; // Persistent and coherent, written directly
+    u32 alignment; // GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT
+    u32 frame_size;
+    u32 frame_index;
+    u32 offset; // Where the next push goes
+    u32 frame_end;
+    GLsync fences[UNIFORM_RING_FRAMES]; // Signaled when the GPU is done with a frame's part
+} uniformring_t; // Per frame uniform data, one part per frame in flight
+
+typedef struct {
+    u32 program;
+    u32 vao;
+    u32 active_unit;
+    u32 textures[GL_STATE_TEXTURE_UNITS][2]; // GL_TEXTURE_2D and GL_TEXTURE_2D_ARRAY
+    u32 enabled_flags; // GL_STATE_*
+    u32 blend_func; // Source factor in the high half
+    u32 cull_mode;
+    u32 issued_count;
+    u32 skipped_count;
+} glstate_t; // See glstate.c
+
+typedef struct {
+    u64 key; // Pass, program, texture, VAO, depth from the top bits down
+    u32 i_packet;
+    u32 padding;
+} renderkey_t;
+
+typedef struct {
+    gameobject_t* p_go;
+    u32 program;
+    float model[16];
+} renderpacket_t;
+
+typedef struct {
+    renderpacket_t* packets;
+    renderkey_t* keys; // Sorted, the packets stay where they were pushed
+    u32 count;
+    u32 capacity;
+    float eye[3];
+    float inv_depth_range; // Depth is quantized over [0, far]
+} renderqueue_t; // Draws of a frame, submitted in state order
+
 typedef struct {
     float* vertex_data;
+    void* index_data; // u16 or u32, depending on index_size
     u32 vertex_count;
+    u32 index_count;
+    u32 index_size; // In bytes
     char texture_name[MTL_TEXTURE_FILENAME_LEN];
+    u32 texture_flags; // TEXTURE_FLAG_*
+    u32 lod_count;
+    meshlod_t lods[MESH_MAX_LODS]; // Ranges of index_data, lods[0] is the full mesh
+    meshlet_t* meshlets; // Over lods[0], none for small meshes
+    u32 meshlet_count;
 } mesh_t; // Render-ready data
 
+typedef struct {
+    float sort_key;
+    u32 first_triangle;
+    u32 triangle_count;
+} meshcluster_t; // Run of triangles that the optimizer keeps together
+
+typedef struct {
+    float position; // In model units
+    float uv;
+    float normal_degrees;
+} quanterror_t; // Largest error of a quantized mesh
+
+typedef struct {
+    float a00, a11, a22, a10, a20, a21; // Symmetric 3x3
+    float b0, b1, b2;
+    float c;
+    float weight; // Total of the planes' weights
+} meshquadric_t; // Sum of squared distances to a set of planes
+
+typedef struct {
+    float cost;
+    u32 from;
+    u32 to;
+} meshcollapse_t; // Moves vertex group "from" onto "to"
+
 typedef struct {
     char name[MTL_NAME_LEN];
     char texture_name[MTL_TEXTURE_FILENAME_LEN];
+    u32 texture_flags; // TEXTURE_FLAG_*, from the options on the map_Kd line
     // emission etc here
 } mtldata_t; // Single material data
 
@@ -68,20 +337,184 @@ typedef struct {
     u32 mtl_count;
 } mtlasset_t;
 
+typedef struct {
+    u8* base;
+    u64 reserved;
+    u64 committed;
+    u64 used;
+    u64 high_water;
+    u32 alloc_count;
+} arena_t;
+
 typedef struct {
     char mtl_name[MTL_NAME_LEN]; // usemtl argument
-    u32* face_data; // Array of [v/u/n v/u/n v/u/n]
+    u32* face_data; // Array of [v/u/n v/u/n v/u/n], 0-based
     u32 face_count; // Number of face rows
+    u32 face_capacity;
 } objsubdata_t;
 
 typedef struct {
     float* positions;
     float* uvs;
     float* normals;
+    u32 position_count; // In elements, i.e. 3 floats per position
+    u32 uv_count;
+    u32 normal_count;
+    u32 position_capacity;
+    u32 uv_capacity;
+    u32 normal_capacity;
     objsubdata_t* subs;
     u32 mtl_count;
+    u32 mtl_capacity;
+    i32 i_curr_mtl; // Active group, carried over between parse calls. -1 if none
+    arena_t* arena; // Where all of the above grow
+    char mtllib_name[MTL_FILENAME_LEN];
 } objasset_t;
 
+typedef void (*objbatch_callback_t)(mesh_t* p_batch, void* user_data); // For streaming loads
+
+typedef struct {
+    mesh_t* meshes; // MTL_MAX_COUNT of them, in mesh_arena
+    u32 mesh_count;
+    u32 vertex_capacities[MTL_MAX_COUNT];
+    u32 index_capacities[MTL_MAX_COUNT];
+    arena_t* mesh_arena;
+} objstreammeshes_t; // Batches of a streamed load, gathered back into a mesh per material
+
+typedef struct {
+    u8* data; // Read-only view
+    u64 size;
+    HANDLE file;
+    HANDLE mapping;
+    bool owns_data; // Decompressed out of the pack, freed on unmap
+} filemap_t;
+
+typedef struct {
+    u32 magic;
+    u32 version;
+    u32 entry_count;
+    u32 bucket_count; // Power of two
+    u64 toc_offset; // packentry_t[entry_count]
+    u64 bucket_offset; // u32[bucket_count], entry index + 1, 0 is empty
+} packheader_t; // Header of assets.p7pack, file blobs follow
+
+typedef struct {
+    u64 path_hash; // Of the lower-cased path
+    u64 offset; // From the start of the pack
+    u64 size; // Uncompressed
+    u64 stored_size; // In the pack, the block table included
+    u64 mtime; // Of the loose file when it was packed
+    u32 block_count; // 0 if stored as is. Otherwise u32[block_count] compressed sizes, then the blocks
+    u32 reserved;
+    char path[PACK_PATH_LEN]; // Normalized, "textures/a.png"
+} packentry_t;
+
+typedef struct {
+    filemap_t pack_file;
+    packheader_t* p_header; // NULL if nothing is mounted
+    packentry_t* entries;
+    u32* buckets;
+    volatile LONG hit_count;
+    volatile LONG miss_count;
+} vfs_t;
+
+typedef struct {
+    packentry_t* p_entry;
+    u8* dst; // The whole entry's destination
+    u32 first_block;
+    u32 block_count;
+    bool failed;
+} packchunk_t; // A thread's share of a compressed entry
+
+typedef struct {
+    u32 magic;
+    u32 version;
+    u64 source_size;
+    u64 source_mtime;
+    u64 source_hash;
+    u64 mtl_size; // Of the .mtl the .obj uses, the texture names and flags come from there
+    u64 mtl_mtime;
+    u32 mesh_count;
+    u32 reserved;
+} meshcache_header_t; // Header of a .p7mesh file
+
+typedef struct {
+    u64 vertex_offset; // From the start of the file
+    u64 index_offset;
+    u64 meshlet_offset;
+    u32 vertex_count;
+    u32 index_count;
+    u32 index_size;
+    u32 texture_flags;
+    char texture_name[MTL_TEXTURE_FILENAME_LEN];
+    u32 lod_count;
+    meshlod_t lods[MESH_MAX_LODS];
+    u32 meshlet_count;
+} meshcache_entry_t; // One per mesh, right after the header
+
+typedef struct {
+    u32 magic;
+    u32 version;
+    u64 source_size;
+    u64 source_mtime;
+    u32 gl_format; // GL_COMPRESSED_RGB_S3TC_DXT1_EXT (BC1) or GL_COMPRESSED_RGBA_S3TC_DXT5_EXT (BC3)
+    u32 width;
+    u32 height;
+    u32 mip_count;
+} texbake_header_t; // Header of a .p7tex file
+
+typedef struct {
+    u64 offset; // From the start of the file
+    u32 size;
+    u32 width;
+    u32 height;
+    u32 reserved;
+} texbake_mip_t; // One per mip level, right after the header. Blocks follow, largest mip first
+
+typedef enum {
+    TEXTURE_STATE_EMPTY, // Free slot
+    TEXTURE_STATE_QUEUED, // Waiting for, or being decoded on a worker
+    TEXTURE_STATE_DECODED, // Pixels are waiting for the main thread to upload them
+    TEXTURE_STATE_READY,
+    TEXTURE_STATE_FAILED, // Couldn't be read or decoded, keeps the placeholder
+} texturestate_t;
+
+typedef struct {
+    char path[MAX_PATH]; // Normalized, this is the key
+    u64 path_hash;
+    u32 handle; // GL array texture, a placeholder until the image is uploaded
+    u32 layer; // In the array
+    u32 ref_count;
+    u32 hit_count; // Acquires after the first one
+    u32 width;
+    u32 height;
+    u32 flags; // TEXTURE_FLAG_*, part of the key
+    u32 internal_format;
+    u32 pixel_format; // GL_RED...GL_RGBA for decoded pixels, 0 for baked blocks
+    u32 mip_count;
+    u8* pixels; // 1 to 4 channels from the decoder, as many as the image has. Freed after the upload
+    filemap_t baked_file; // Or the .p7tex blocks, unmapped after the upload
+    u64 vram_size; // Known after the upload
+    volatile LONG state; // texturestate_t, workers hand the texture back through this
+    double decode_time; // Seconds
+} texture_t;
+
+typedef struct {
+    texture_t entries[TEXTURE_CACHE_MAX];
+    u32 texture_count;
+    u32 hit_count;
+    u32 pending_count; // Acquired but not uploaded yet
+    bool pack_arrays; // Share arrays between textures of the same size and format
+    u32 upload_pbo;
+    HANDLE worker_threads[TEXTURE_DECODE_MAX_THREADS];
+    u32 worker_count;
+    HANDLE job_semaphore;
+    u32 job_queue[TEXTURE_CACHE_MAX]; // Ring of slot indices, at most one job per slot
+    u32 job_push_count; // Main thread only
+    volatile LONG job_pop_count;
+    volatile LONG quitting;
+} texturecache_t;
+
 typedef struct {
     stbtt_bakedchar font_char_data[FONT_CHAR_COUNT];
     float text_scale;
@@ -96,18 +529,31 @@ typedef struct {
 } uitext_t;
 
 #include "geom.c"
+#include "arena.c"
+#include "glstate.c"
+#include "lz.c"
+#include "vfs.c"
+#include "meshopt.c"
+#include "parsefloat.c"
 #include "assets.c"
+#include "texture.c"
+#include "texbake.c"
+#include "packbuild.c"
 
 u32 create_shader(char* vert_shader_filename, char* frag_shader_filename) {
-    char* vert_shader_source = read_entire_file(vert_shader_filename);
-    char* frag_shader_source = read_entire_file(frag_shader_filename);
+    filemap_t vert_shader_file = read_entire_file(vert_shader_filename);
+    filemap_t frag_shader_file = read_entire_file(frag_shader_filename);
+    const char* vert_shader_source = (const char*)vert_shader_file.data;
+    const char* frag_shader_source = (const char*)frag_shader_file.data;
+    i32 vert_shader_length = (i32)vert_shader_file.size; // Views aren't null-terminated
+    i32 frag_shader_length = (i32)frag_shader_file.size;
 
     int success;
     char info_log[512];
 
     // Vert
     u32 vert_shader_handle = glCreateShader(GL_VERTEX_SHADER);
-    glShaderSource(vert_shader_handle, 1, &vert_shader_source, NULL);
+    glShaderSource(vert_shader_handle, 1, &vert_shader_source, &vert_shader_length);
     glCompileShader(vert_shader_handle);
 
     glGetShaderiv(vert_shader_handle, GL_COMPILE_STATUS, &success);
@@ -118,7 +564,7 @@ u32 create_shader(char* vert_shader_filename, char* frag_shader_filename) {
 
     // Frag
     u32 frag_shader_handle = glCreateShader(GL_FRAGMENT_SHADER);
-    glShaderSource(frag_shader_handle, 1, &frag_shader_source, NULL);
+    glShaderSource(frag_shader_handle, 1, &frag_shader_source, &frag_shader_length);
     glCompileShader(frag_shader_handle);
 
     glGetShaderiv(frag_shader_handle, GL_COMPILE_STATUS, &success);
@@ -139,71 +585,601 @@ u32 create_shader(char* vert_shader_filename, char* frag_shader_filename) {
         printf("shader link error: %s\n", info_log);
     }
 
-    free(vert_shader_source);
-    free(frag_shader_source);
+    // Blocks go to fixed binding points, so one buffer binding serves every program that uses them
+    u32 camera_block = glGetUniformBlockIndex(shader_program, "camera_block");
+    if (camera_block != GL_INVALID_INDEX) glUniformBlockBinding(shader_program, camera_block, UNIFORM_BINDING_CAMERA);
+    u32 object_block = glGetUniformBlockIndex(shader_program, "object_block");
+    if (object_block != GL_INVALID_INDEX) glUniformBlockBinding(shader_program, object_block, UNIFORM_BINDING_OBJECT);
+
+    unmap_file(&vert_shader_file);
+    unmap_file(&frag_shader_file);
     glDeleteShader(vert_shader_handle);
     glDeleteShader(frag_shader_handle);
 
     return shader_program;
 }
 
-void render_create_buffer(gameobject_t* p_go, mesh_t* p_mesh) {
-    p_go->vertex_count = p_mesh->vertex_count;
-    glGenVertexArrays(1, &(p_go->vao));
-    glGenBuffers(1, &(p_go->vbo));
+void uniform_ring_create(uniformring_t* p_ring, u32 frame_size) {
+    i32 alignment;
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+    p_ring->alignment = (u32)alignment;
+    p_ring->frame_size = frame_size;
+    u32 size = frame_size * UNIFORM_RING_FRAMES;
+    GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+    glGenBuffers(1, &p_ring->buffer);
+    glBindBuffer(GL_UNIFORM_BUFFER, p_ring->buffer);
+    glBufferStorage(GL_UNIFORM_BUFFER, size, NULL, flags);
+    p_ring->p_mapped = glMapBufferRange(GL_UNIFORM_BUFFER, 0, size, flags);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
+
+void uniform_ring_destroy(uniformring_t* p_ring) {
+    for (u32 i = 0; i < UNIFORM_RING_FRAMES; i++) {
+        if (p_ring->fences[i] != NULL) glDeleteSync(p_ring->fences[i]);
+    }
+    glBindBuffer(GL_UNIFORM_BUFFER, p_ring->buffer);
+    glUnmapBuffer(GL_UNIFORM_BUFFER);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    glDeleteBuffers(1, &p_ring->buffer);
+}
+
+void* uniform_ring_alloc(uniformring_t* p_ring, u32 size, u32* p_offset) {
+    // Space for this frame, to be written directly. "p_offset" gets the offset to bind
+    u32 offset = p_ring->offset;
+    if (offset + size > p_ring->frame_end) {
+        printf("uniform ring is full, its frame size is too small\n");
+        assert(false);
+    }
+    p_ring->offset = (offset + size + p_ring->alignment - 1) / p_ring->alignment * p_ring->alignment;
+    *p_offset = offset;
+    return p_ring->p_mapped + offset;
+}
 
-    glBindVertexArray(p_go->vao);
-    glBindBuffer(GL_ARRAY_BUFFER, p_go->vbo);
-    glBufferData(GL_ARRAY_BUFFER, p_mesh->vertex_count * 8 * sizeof(float), p_mesh->vertex_data, GL_STATIC_DRAW); 
+u32 uniform_ring_push(uniformring_t* p_ring, void* data, u32 size) {
+    // Returns the offset to bind
+    u32 offset;
+    memcpy(uniform_ring_alloc(p_ring, size, &offset), data, size);
+    return offset;
+}
 
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)0);
+void uniform_ring_begin_frame(uniformring_t* p_ring, cameradata_t* p_camera) {
+    // Waits until the GPU is done with this frame's part from UNIFORM_RING_FRAMES ago, then binds the camera
+    u32 part = p_ring->frame_index % UNIFORM_RING_FRAMES;
+    if (p_ring->fences[part] != NULL) {
+        while (glClientWaitSync(p_ring->fences[part], GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000) == GL_TIMEOUT_EXPIRED) { }
+        glDeleteSync(p_ring->fences[part]);
+        p_ring->fences[part] = NULL;
+    }
+    p_ring->offset = part * p_ring->frame_size;
+    p_ring->frame_end = p_ring->offset + p_ring->frame_size;
+
+    u32 camera_offset = uniform_ring_push(p_ring, p_camera, sizeof(cameradata_t));
+    glBindBufferRange(GL_UNIFORM_BUFFER, UNIFORM_BINDING_CAMERA, p_ring->buffer, camera_offset, sizeof(cameradata_t));
+}
+
+void uniform_ring_end_frame(uniformring_t* p_ring, renderstats_t* p_stats) {
+    u32 part = p_ring->frame_index % UNIFORM_RING_FRAMES;
+    p_stats->uniform_bytes = p_ring->offset - part * p_ring->frame_size;
+    p_ring->fences[part] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    p_ring->frame_index++;
+}
+
+cameradata_t render_camera(mat44* p_view, mat44* p_proj, vec3 eye) {
+    cameradata_t camera = { 0 };
+    mat44 view_proj = mat44_mul(p_proj, p_view);
+    memcpy(camera.view, p_view->data, sizeof(camera.view));
+    memcpy(camera.proj, p_proj->data, sizeof(camera.proj));
+    memcpy(camera.view_proj, view_proj.data, sizeof(camera.view_proj));
+    camera.eye[0] = eye.x;
+    camera.eye[1] = eye.y;
+    camera.eye[2] = eye.z;
+    return camera;
+}
+
+void render_set_vertex_format(bool compact_vertices) {
+    // Attributes 0 to 2 from the bound array buffer, recorded into the bound VAO
+    if (compact_vertices) {
+        // Positions and uvs go to the shader as integers, the dequant uniform scales them
+        glVertexAttribPointer(0, 3, GL_UNSIGNED_SHORT, GL_FALSE, MESH_COMPACT_VERTEX_SIZE, (void*)0);
+        glVertexAttribPointer(1, 2, GL_UNSIGNED_SHORT, GL_FALSE, MESH_COMPACT_VERTEX_SIZE, (void*)(3 * sizeof(u16)));
+        glVertexAttribPointer(2, 2, GL_SHORT, GL_TRUE, MESH_COMPACT_VERTEX_SIZE, (void*)(5 * sizeof(u16)));
+    } else {
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, MESH_VERTEX_SIZE, (void*)0);
+        glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, MESH_VERTEX_SIZE, (void*)(3 * sizeof(float)));
+        glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, MESH_VERTEX_SIZE, (void*)(5 * sizeof(float)));
+    }
     glEnableVertexAttribArray(0);
-    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(3 * sizeof(float)));
     glEnableVertexAttribArray(1);
-    glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(5 * sizeof(float)));
     glEnableVertexAttribArray(2);
+}
+
+void render_pool_create(geometrypool_t* p_pool, u32 vertex_capacity, u32 index_capacity, bool compact_vertices) {
+    // Meshes are added with render_create_buffer and stay until the pool is destroyed
+    p_pool->vertex_size = compact_vertices ? MESH_COMPACT_VERTEX_SIZE : MESH_VERTEX_SIZE;
+    p_pool->vertex_capacity = vertex_capacity;
+    p_pool->index_capacity = index_capacity;
+    p_pool->vertex_count = 0;
+    p_pool->index_count = 0;
+    glGenVertexArrays(1, &(p_pool->vao));
+    glGenBuffers(1, &(p_pool->vbo));
+    glGenBuffers(1, &(p_pool->ebo));
+
+    gl_state_bind_vao(p_pool->vao);
+    glBindBuffer(GL_ARRAY_BUFFER, p_pool->vbo);
+    glBufferData(GL_ARRAY_BUFFER, (u64)vertex_capacity * p_pool->vertex_size, NULL, GL_STATIC_DRAW);
+    render_set_vertex_format(compact_vertices);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, p_pool->ebo);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, (u64)index_capacity * sizeof(u32), NULL, GL_STATIC_DRAW);
+
+    // Per draw attributes, the model matrix's columns in 3 to 6, the layer in 7 and the dequant in 8 to 10.
+    // Their buffer is bound for each multi draw, the vertex buffer stands in until then
+    for (u32 i = 0; i < 4; i++) {
+        glVertexAttribFormat(3 + i, 4, GL_FLOAT, GL_FALSE, (GLuint)(i * 4 * sizeof(float)));
+        glVertexAttribBinding(3 + i, GEOMETRY_POOL_DRAW_BINDING);
+        glEnableVertexAttribArray(3 + i);
+    }
+    glVertexAttribIFormat(7, 1, GL_INT, (GLuint)(16 * sizeof(float)));
+    glVertexAttribBinding(7, GEOMETRY_POOL_DRAW_BINDING);
+    glEnableVertexAttribArray(7);
+    for (u32 i = 0; i < 3; i++) {
+        glVertexAttribFormat(8 + i, 4, GL_FLOAT, GL_FALSE, (GLuint)(16 * sizeof(float) + sizeof(i32) + i * 4 * sizeof(float)));
+        glVertexAttribBinding(8 + i, GEOMETRY_POOL_DRAW_BINDING);
+        glEnableVertexAttribArray(8 + i);
+    }
+    glVertexBindingDivisor(GEOMETRY_POOL_DRAW_BINDING, 1);
+    glBindVertexBuffer(GEOMETRY_POOL_DRAW_BINDING, p_pool->vbo, 0, 0);
 
-    glBindVertexArray(0);
+    gl_state_bind_vao(0);
     glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
 
-    glGenTextures(1, &(p_go->tex_handle));
-    glBindTexture(GL_TEXTURE_2D, p_go->tex_handle);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);   
-    int img_width, img_height, img_channel_count;
-    stbi_set_flip_vertically_on_load(true);
-    u8* image_data = stbi_load(p_mesh->texture_name, &img_width, &img_height, &img_channel_count, 0);
-    if (!image_data) {
-        printf("problem with texture file: %s\n", p_mesh->texture_name);
+void render_pool_destroy(geometrypool_t* p_pool) {
+    gl_state_delete_vao(&(p_pool->vao));
+    glDeleteBuffers(1, &(p_pool->vbo));
+    glDeleteBuffers(1, &(p_pool->ebo));
+}
+
+void render_create_buffer(gameobject_t* p_go, mesh_t* p_mesh, texturecache_t* texture_cache, bool compact_vertices, geometrypool_t* p_pool) {
+    // The mesh gets buffers and a VAO of its own, or goes into "p_pool" if it's set
+    p_go->index_type = (p_mesh->index_size == 2) ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+    p_go->index_size = p_mesh->index_size;
+    p_go->lod_count = p_mesh->lod_count;
+    memcpy(p_go->lods, p_mesh->lods, sizeof(p_go->lods));
+    p_go->current_lod = 0;
+
+    // Bounding sphere around the box's center, loose but enough to measure distance with
+    vec3 min = { FLT_MAX, FLT_MAX, FLT_MAX };
+    vec3 max = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+    for (u32 i = 0; i < p_mesh->vertex_count; i++) {
+        float* p = &p_mesh->vertex_data[i * 8];
+        min = (vec3){ fminf(min.x, p[0]), fminf(min.y, p[1]), fminf(min.z, p[2]) };
+        max = (vec3){ fmaxf(max.x, p[0]), fmaxf(max.y, p[1]), fmaxf(max.z, p[2]) };
+    }
+    vec3 center = v3_scale(v3_add(min, max), 0.5f);
+    float radius_squared = 0;
+    for (u32 i = 0; i < p_mesh->vertex_count; i++) {
+        float* p = &p_mesh->vertex_data[i * 8];
+        vec3 d = v3_sub((vec3){ p[0], p[1], p[2] }, center);
+        radius_squared = fmaxf(radius_squared, v3_dot(d, d));
+    }
+    p_go->bounds[0] = center.x;
+    p_go->bounds[1] = center.y;
+    p_go->bounds[2] = center.z;
+    p_go->bounds[3] = sqrtf(radius_squared);
+
+    p_go->meshlet_count = p_mesh->meshlet_count;
+    p_go->meshlets = NULL;
+    if (p_mesh->meshlet_count > 0) {
+        p_go->meshlets = malloc(p_mesh->meshlet_count * sizeof(meshlet_t)); // The mesh's copy goes away after upload
+        memcpy(p_go->meshlets, p_mesh->meshlets, p_mesh->meshlet_count * sizeof(meshlet_t));
+    }
+    arena_t* scratch = get_scratch_arena(0);
+    u64 scratch_mark = arena_mark(scratch);
+    u32 vertex_size = compact_vertices ? MESH_COMPACT_VERTEX_SIZE : MESH_VERTEX_SIZE;
+    void* vertex_data = p_mesh->vertex_data;
+    if (compact_vertices) {
+        vertex_data = arena_push(scratch, p_mesh->vertex_count * MESH_COMPACT_VERTEX_SIZE);
+        quanterror_t error;
+        mesh_quantize(p_mesh, vertex_data, p_go->dequant, &error);
+        printf("  %s: %u vertices, %.1f -> %.1f KB, max error: position %.6f, uv %.6f, normal %.4f deg\n", p_mesh->texture_name,
+                p_mesh->vertex_count, p_mesh->vertex_count * MESH_VERTEX_SIZE / 1024.0, p_mesh->vertex_count * MESH_COMPACT_VERTEX_SIZE / 1024.0,
+                error.position, error.uv, error.normal_degrees);
+    } else {
+        float dequant[12] = { 0, 0, 0, 0, 1, 1, 1, 0, 0, 0, 1, 1 }; // Identity, plain normals
+        memcpy(p_go->dequant, dequant, sizeof(dequant));
+    }
+
+    p_go->p_pool = p_pool;
+    if (p_pool != NULL) {
+        // Indices are widened and rebased onto the mesh's first vertex, and the LOD and meshlet
+        // ranges move to its first index, so drawing from the pool is the same as drawing alone
+        assert(p_pool->vertex_size == vertex_size);
+        if (p_pool->vertex_count + p_mesh->vertex_count > p_pool->vertex_capacity || p_pool->index_count + p_mesh->index_count > p_pool->index_capacity) {
+            printf("geometry pool is full\n");
+            assert(false);
+        }
+        u32* index_data = arena_push(scratch, p_mesh->index_count * sizeof(u32));
+        for (u32 i = 0; i < p_mesh->index_count; i++) {
+            u32 index = (p_mesh->index_size == 2) ? ((u16*)p_mesh->index_data)[i] : ((u32*)p_mesh->index_data)[i];
+            index_data[i] = p_pool->vertex_count + index;
+        }
+        for (u32 i = 0; i < p_go->lod_count; i++) {
+            p_go->lods[i].first_index += p_pool->index_count;
+        }
+        for (u32 i = 0; i < p_go->meshlet_count; i++) {
+            p_go->meshlets[i].first_index += p_pool->index_count;
+        }
+
+        p_go->vao = p_pool->vao;
+        p_go->vbo = 0;
+        p_go->ebo = 0;
+        p_go->index_type = GL_UNSIGNED_INT;
+        p_go->index_size = sizeof(u32);
+        gl_state_bind_vao(p_pool->vao); // For its element buffer
+        glBindBuffer(GL_ARRAY_BUFFER, p_pool->vbo);
+        glBufferSubData(GL_ARRAY_BUFFER, (u64)p_pool->vertex_count * vertex_size, p_mesh->vertex_count * vertex_size, vertex_data);
+        glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, (u64)p_pool->index_count * sizeof(u32), p_mesh->index_count * sizeof(u32), index_data);
+        p_pool->vertex_count += p_mesh->vertex_count;
+        p_pool->index_count += p_mesh->index_count;
+    } else {
+        glGenVertexArrays(1, &(p_go->vao));
+        glGenBuffers(1, &(p_go->vbo));
+        glGenBuffers(1, &(p_go->ebo));
+        gl_state_bind_vao(p_go->vao);
+        glBindBuffer(GL_ARRAY_BUFFER, p_go->vbo);
+        glBufferData(GL_ARRAY_BUFFER, p_mesh->vertex_count * vertex_size, vertex_data, GL_STATIC_DRAW);
+        render_set_vertex_format(compact_vertices);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, p_go->ebo); // Recorded into the VAO
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, p_mesh->index_count * p_mesh->index_size, p_mesh->index_data, GL_STATIC_DRAW); 
+    }
+    gl_state_bind_vao(0); // Keeps later element buffer binds out of this VAO
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    arena_pop_to(scratch, scratch_mark);
+
+    p_go->texture_id = texture_acquire(texture_cache, p_mesh->texture_name, p_mesh->texture_flags);
+}
+
+void render_create_instances(gameobject_t* p_go, instancedata_t* instances, u32 instance_count) {
+    // Adds per instance attributes to the mesh's VAO, the model matrix's columns in 3 to 6 and the layer in 7.
+    // Every draw of the mesh is instanced from then on. Pooled meshes share their VAO, so they can't be
+    assert(p_go->p_pool == NULL);
+    p_go->instance_count = instance_count;
+    glGenBuffers(1, &(p_go->instance_buffer));
+
+    gl_state_bind_vao(p_go->vao);
+    glBindBuffer(GL_ARRAY_BUFFER, p_go->instance_buffer);
+    glBufferData(GL_ARRAY_BUFFER, instance_count * sizeof(instancedata_t), instances, GL_STATIC_DRAW);
+    for (u32 i = 0; i < 4; i++) {
+        glVertexAttribPointer(3 + i, 4, GL_FLOAT, GL_FALSE, sizeof(instancedata_t), (void*)(i * 4 * sizeof(float)));
+        glVertexAttribDivisor(3 + i, 1);
+        glEnableVertexAttribArray(3 + i);
+    }
+    glVertexAttribIPointer(7, 1, GL_INT, sizeof(instancedata_t), (void*)(16 * sizeof(float)));
+    glVertexAttribDivisor(7, 1);
+    glEnableVertexAttribArray(7);
+
+    gl_state_bind_vao(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void render_delete_go(gameobject_t* p_go, texturecache_t* texture_cache) {
+    // Pooled meshes keep their space until the pool is destroyed
+    if (p_go->p_pool == NULL) {
+        gl_state_delete_vao(&(p_go->vao));
+        glDeleteBuffers(1, &(p_go->vbo));
+        glDeleteBuffers(1, &(p_go->ebo));
+        glDeleteBuffers(1, &(p_go->instance_buffer)); // Zero is ignored
+    }
+    p_go->vao = 0;
+    free(p_go->meshlets);
+    texture_release(texture_cache, p_go->texture_id);
+}
+
+u32 render_cull_meshlets(gameobject_t* p_go, cameradata_t* p_camera, mat44* p_model, GLsizei* counts, void** offsets, renderstats_t* p_stats) {
+    // Drops meshlets outside the frustum or facing away from the eye, and merges the
+    // ranges of neighbours that survive. Returns the range count. Works in model space,
+    // "p_model" has to be a rotation and translation
+    mat44 view_proj;
+    memcpy(view_proj.data, p_camera->view_proj, sizeof(view_proj.data));
+    mat44 clip = mat44_mul(&view_proj, p_model);
+    float planes[6][4];
+    for (u32 i = 0; i < 3; i++) {
+        for (u32 j = 0; j < 4; j++) {
+            planes[i * 2 + 0][j] = clip.data[j * 4 + 3] + clip.data[j * 4 + i];
+            planes[i * 2 + 1][j] = clip.data[j * 4 + 3] - clip.data[j * 4 + i];
+        }
+    }
+    for (u32 i = 0; i < 6; i++) {
+        float length = sqrtf(planes[i][0] * planes[i][0] + planes[i][1] * planes[i][1] + planes[i][2] * planes[i][2]);
+        for (u32 j = 0; j < 4; j++) planes[i][j] /= length;
+    }
+    vec3 to_eye = { p_camera->eye[0] - p_model->data[12], p_camera->eye[1] - p_model->data[13], p_camera->eye[2] - p_model->data[14] };
+    vec3 eye = { // Transposed rotation
+        p_model->data[0] * to_eye.x + p_model->data[1] * to_eye.y + p_model->data[2] * to_eye.z,
+        p_model->data[4] * to_eye.x + p_model->data[5] * to_eye.y + p_model->data[6] * to_eye.z,
+        p_model->data[8] * to_eye.x + p_model->data[9] * to_eye.y + p_model->data[10] * to_eye.z,
+    };
+
+    u32 range_count = 0;
+    u32 range_end = 0; // Index after the last range
+    for (u32 i_meshlet = 0; i_meshlet < p_go->meshlet_count; i_meshlet++) {
+        meshlet_t* p_meshlet = &p_go->meshlets[i_meshlet];
+        vec3 center = { p_meshlet->center[0], p_meshlet->center[1], p_meshlet->center[2] };
+        bool visible = true;
+        for (u32 i = 0; i < 6 && visible; i++) {
+            visible = planes[i][0] * center.x + planes[i][1] * center.y + planes[i][2] * center.z + planes[i][3] >= -p_meshlet->radius;
+        }
+        if (visible) {
+            // Every triangle faces away if the eye is behind the cone, with the sphere's slack
+            vec3 from_eye = v3_sub(center, eye);
+            vec3 axis = { p_meshlet->cone_axis[0], p_meshlet->cone_axis[1], p_meshlet->cone_axis[2] };
+            visible = v3_dot(from_eye, axis) < p_meshlet->cone_cutoff * sqrtf(v3_dot(from_eye, from_eye)) + p_meshlet->radius;
+        }
+        p_stats->meshlet_count++;
+        if (!visible) {
+            p_stats->meshlet_culled_count++;
+            p_stats->culled_vertex_count += p_meshlet->vertex_count;
+            continue;
+        }
+
+        u32 index_count = p_meshlet->triangle_count * 3;
+        if (range_count > 0 && range_end == p_meshlet->first_index) {
+            counts[range_count - 1] += index_count;
+        } else {
+            counts[range_count] = index_count;
+            offsets[range_count] = (void*)((u64)p_meshlet->first_index * p_go->index_size);
+            range_count++;
+        }
+        range_end = p_meshlet->first_index + index_count;
+        p_stats->triangle_count += p_meshlet->triangle_count;
+    }
+    return range_count;
+}
+
+void render_draw_go(gameobject_t* p_go, texturecache_t* texture_cache, uniformring_t* p_ring, cameradata_t* p_cull_camera, mat44* p_model, renderstats_t* p_stats) {
+    // Meshlets are culled when there's a camera to cull against and the full mesh is drawn. Instanced
+    // meshes are drawn whole at their current LOD, "p_model" places all of their instances
+    // Binds that don't change anything are skipped by the state cache, the render queue sorts draws so few are left
+    texture_t* p_texture = &texture_cache->entries[p_go->texture_id];
+    if (gl_state_bind_texture(0, GL_TEXTURE_2D_ARRAY, p_texture->handle)) p_stats->texture_bind_count++;
+    objectdata_t object = { 0 };
+    memcpy(object.model, p_model->data, sizeof(object.model));
+    memcpy(object.dequant, p_go->dequant, sizeof(object.dequant));
+    object.layer = (i32)p_texture->layer;
+    object.draw_mode = (p_go->instance_count > 0) ? RENDER_DRAW_INSTANCED : RENDER_DRAW_SINGLE;
+    u32 object_offset = uniform_ring_push(p_ring, &object, sizeof(object));
+    glBindBufferRange(GL_UNIFORM_BUFFER, UNIFORM_BINDING_OBJECT, p_ring->buffer, object_offset, sizeof(object));
+
+    if (gl_state_bind_vao(p_go->vao)) p_stats->vao_switch_count++;
+    if (p_go->instance_count > 0) {
+        meshlod_t* p_lod = &p_go->lods[p_go->current_lod];
+        glDrawElementsInstanced(GL_TRIANGLES, p_lod->index_count, p_go->index_type, (void*)((u64)p_lod->first_index * p_go->index_size), p_go->instance_count);
+        p_stats->draw_count++;
+        p_stats->instance_count += p_go->instance_count;
+        p_stats->triangle_count += p_lod->index_count / 3 * p_go->instance_count;
+    } else if (p_cull_camera != NULL && p_go->current_lod == 0 && p_go->meshlet_count > 0) {
+        arena_t* scratch = get_scratch_arena(0);
+        u64 scratch_mark = arena_mark(scratch);
+        GLsizei* counts = arena_push(scratch, p_go->meshlet_count * sizeof(GLsizei));
+        void** offsets = arena_push(scratch, p_go->meshlet_count * sizeof(void*));
+        u32 range_count = render_cull_meshlets(p_go, p_cull_camera, p_model, counts, offsets, p_stats);
+        if (range_count > 0) {
+            glMultiDrawElements(GL_TRIANGLES, counts, p_go->index_type, (const void* const*)offsets, range_count);
+            p_stats->draw_count++;
+        }
+        arena_pop_to(scratch, scratch_mark);
+    } else {
+        meshlod_t* p_lod = &p_go->lods[p_go->current_lod];
+        glDrawElements(GL_TRIANGLES, p_lod->index_count, p_go->index_type, (void*)((u64)p_lod->first_index * p_go->index_size));
+        p_stats->draw_count++;
+        p_stats->triangle_count += p_lod->index_count / 3;
+    }
+}
+
+void render_select_lod(gameobject_t* p_go, vec3 position, vec3 eye, float lod_scale) {
+    // "lod_scale" turns a size at a distance of 1 into pixels. Goes finer while the current level's
+    // error is over the limit on screen, coarser while the next one is comfortably under it
+    vec3 center = v3_add(position, (vec3){ p_go->bounds[0], p_go->bounds[1], p_go->bounds[2] });
+    vec3 to_center = v3_sub(center, eye);
+    float distance = fmaxf(sqrtf(v3_dot(to_center, to_center)) - p_go->bounds[3], 0.001f); // Nearest the mesh can be
+    float pixels_per_unit = lod_scale / distance;
+
+    u32 lod = p_go->current_lod;
+    while (lod > 0 && p_go->lods[lod].error * pixels_per_unit > LOD_MAX_PIXEL_ERROR) {
+        lod--;
+    }
+    while (lod + 1 < p_go->lod_count && p_go->lods[lod + 1].error * pixels_per_unit < LOD_MAX_PIXEL_ERROR * LOD_HYSTERESIS) {
+        lod++;
+    }
+    p_go->current_lod = lod;
+}
+
+void render_queue_create(renderqueue_t* p_queue, u32 capacity) {
+    p_queue->packets = malloc(capacity * sizeof(renderpacket_t));
+    p_queue->keys = malloc(capacity * sizeof(renderkey_t));
+    p_queue->count = 0;
+    p_queue->capacity = capacity;
+}
+
+void render_queue_destroy(renderqueue_t* p_queue) {
+    free(p_queue->packets);
+    free(p_queue->keys);
+}
+
+void render_queue_begin(renderqueue_t* p_queue, vec3 eye, float far) {
+    p_queue->count = 0;
+    p_queue->eye[0] = eye.x;
+    p_queue->eye[1] = eye.y;
+    p_queue->eye[2] = eye.z;
+    p_queue->inv_depth_range = 1.0f / far;
+}
+
+void render_queue_push(renderqueue_t* p_queue, gameobject_t* p_go, u32 program, texturecache_t* texture_cache, mat44* p_model) {
+    // The key only orders draws, binds are still checked against the real handles when submitting
+    if (p_queue->count == p_queue->capacity) {
+        printf("render queue is full, its capacity is too small\n");
         assert(false);
     }
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, img_width, img_height, 0, GL_RGBA, GL_UNSIGNED_BYTE, image_data);
-    glGenerateMipmap(GL_TEXTURE_2D);
-    stbi_image_free(image_data);
-    glBindTexture(GL_TEXTURE_2D, 0);
+    u32 i_packet = p_queue->count++;
+    renderpacket_t* p_packet = &p_queue->packets[i_packet];
+    p_packet->p_go = p_go;
+    p_packet->program = program;
+    memcpy(p_packet->model, p_model->data, sizeof(p_packet->model));
+
+    // Front to back within the same state, for early depth rejection
+    vec3 center = {
+        p_model->data[12] + p_go->bounds[0] - p_queue->eye[0],
+        p_model->data[13] + p_go->bounds[1] - p_queue->eye[1],
+        p_model->data[14] + p_go->bounds[2] - p_queue->eye[2],
+    };
+    float depth = fminf(sqrtf(v3_dot(center, center)) * p_queue->inv_depth_range, 1.0f);
+    u64 quantized_depth = (u64)(depth * 0xFFFFFF);
+
+    u64 texture = texture_cache->entries[p_go->texture_id].handle;
+    p_queue->keys[i_packet].key = ((u64)RENDER_PASS_OPAQUE << 60) | ((u64)(program & 0xFF) << 52) | ((texture & 0xFFF) << 40)
+        | ((u64)(p_go->vao & 0xFFFF) << 24) | quantized_depth;
+    p_queue->keys[i_packet].i_packet = i_packet;
 }
 
-void render_delete_go(gameobject_t* p_go) {
-    glDeleteVertexArrays(1, &(p_go->vao));
-    glDeleteBuffers(1, &(p_go->vbo));
-    glDeleteTextures(1, &(p_go->tex_handle));
+void render_queue_sort(renderqueue_t* p_queue) {
+    // LSD radix sort on the keys, a byte per pass. Bytes that are the same in every key are
+    // skipped, which is most of them: there are few programs, textures and VAOs
+    u32 count = p_queue->count;
+    if (count < 2) return;
+    arena_t* scratch = get_scratch_arena(0);
+    u64 scratch_mark = arena_mark(scratch);
+    u32* histograms = arena_push(scratch, 8 * 256 * sizeof(u32));
+    memset(histograms, 0, 8 * 256 * sizeof(u32));
+    for (u32 i = 0; i < count; i++) {
+        u64 key = p_queue->keys[i].key;
+        for (u32 i_byte = 0; i_byte < 8; i_byte++) {
+            histograms[i_byte * 256 + ((key >> (i_byte * 8)) & 0xFF)]++;
+        }
+    }
+
+    renderkey_t* src = p_queue->keys;
+    renderkey_t* dst = arena_push(scratch, count * sizeof(renderkey_t));
+    for (u32 i_byte = 0; i_byte < 8; i_byte++) {
+        u32* histogram = &histograms[i_byte * 256];
+        if (histogram[(src[0].key >> (i_byte * 8)) & 0xFF] == count) continue;
+
+        u32 offset = 0;
+        for (u32 i = 0; i < 256; i++) {
+            u32 bucket_count = histogram[i];
+            histogram[i] = offset;
+            offset += bucket_count;
+        }
+        for (u32 i = 0; i < count; i++) {
+            dst[histogram[(src[i].key >> (i_byte * 8)) & 0xFF]++] = src[i];
+        }
+        renderkey_t* temp = src;
+        src = dst;
+        dst = temp;
+    }
+    if (src != p_queue->keys) memcpy(p_queue->keys, src, count * sizeof(renderkey_t));
+    arena_pop_to(scratch, scratch_mark);
 }
 
-void render_draw_go(gameobject_t* p_go) {
-    glBindVertexArray(p_go->vao);
-    glBindTexture(GL_TEXTURE_2D, p_go->tex_handle);
-    glDrawArrays(GL_TRIANGLES, 0, p_go->vertex_count);
-    glBindVertexArray(0);
+u32 render_pool_draw(renderqueue_t* p_queue, u32 i_first, texturecache_t* texture_cache, uniformring_t* p_ring, cameradata_t* p_cull_camera, renderstats_t* p_stats) {
+    // Draws the run of sorted packets from "i_first" that share its pool, program and texture array with
+    // one glMultiDrawElementsIndirect, and returns where the run ends. Each packet's model, layer and dequant
+    // go to the ring as per instance attributes, and the base instance of its commands picks them. Meshlet
+    // culling leaves a command per range that survives, LODs a command per packet
+    renderpacket_t* p_first_packet = &p_queue->packets[p_queue->keys[i_first].i_packet];
+    gameobject_t* p_first = p_first_packet->p_go;
+    geometrypool_t* p_pool = p_first->p_pool;
+    texture_t* p_texture = &texture_cache->entries[p_first->texture_id];
+    u32 i_end = i_first;
+    u32 max_command_count = 0;
+    while (i_end < p_queue->count) {
+        renderpacket_t* p_packet = &p_queue->packets[p_queue->keys[i_end].i_packet];
+        gameobject_t* p_go = p_packet->p_go;
+        if (p_go->p_pool != p_pool || p_packet->program != p_first_packet->program) break;
+        if (texture_cache->entries[p_go->texture_id].handle != p_texture->handle) break;
+        max_command_count += (p_cull_camera != NULL && p_go->current_lod == 0 && p_go->meshlet_count > 0) ? p_go->meshlet_count : 1;
+        i_end++;
+    }
+
+    if (gl_state_bind_texture(0, GL_TEXTURE_2D_ARRAY, p_texture->handle)) p_stats->texture_bind_count++;
+    objectdata_t object = { 0 };
+    memcpy(object.model, mat44_identity.data, sizeof(object.model));
+    object.draw_mode = RENDER_DRAW_POOLED;
+    u32 object_offset = uniform_ring_push(p_ring, &object, sizeof(object));
+    glBindBufferRange(GL_UNIFORM_BUFFER, UNIFORM_BINDING_OBJECT, p_ring->buffer, object_offset, sizeof(object));
+
+    u32 draw_count = i_end - i_first;
+    u32 draws_offset;
+    pooldraw_t* draws = uniform_ring_alloc(p_ring, draw_count * sizeof(pooldraw_t), &draws_offset);
+    arena_t* scratch = get_scratch_arena(0);
+    u64 scratch_mark = arena_mark(scratch);
+    drawcommand_t* commands = arena_push(scratch, max_command_count * sizeof(drawcommand_t));
+    GLsizei* counts = arena_push(scratch, max_command_count * sizeof(GLsizei));
+    void** offsets = arena_push(scratch, max_command_count * sizeof(void*));
+
+    u32 command_count = 0;
+    for (u32 i_draw = 0; i_draw < draw_count; i_draw++) {
+        renderpacket_t* p_packet = &p_queue->packets[p_queue->keys[i_first + i_draw].i_packet];
+        gameobject_t* p_go = p_packet->p_go;
+        pooldraw_t* p_draw = &draws[i_draw];
+        memcpy(p_draw->model, p_packet->model, sizeof(p_draw->model));
+        p_draw->layer = (i32)texture_cache->entries[p_go->texture_id].layer;
+        memcpy(p_draw->dequant, p_go->dequant, sizeof(p_draw->dequant));
+
+        u32 range_count = 1;
+        if (p_cull_camera != NULL && p_go->current_lod == 0 && p_go->meshlet_count > 0) {
+            range_count = render_cull_meshlets(p_go, p_cull_camera, (mat44*)p_packet->model, counts, offsets, p_stats);
+        } else {
+            meshlod_t* p_lod = &p_go->lods[p_go->current_lod];
+            counts[0] = p_lod->index_count;
+            offsets[0] = (void*)((u64)p_lod->first_index * sizeof(u32));
+            p_stats->triangle_count += p_lod->index_count / 3;
+        }
+        for (u32 i = 0; i < range_count; i++) {
+            drawcommand_t* p_command = &commands[command_count++];
+            p_command->count = counts[i];
+            p_command->instance_count = 1;
+            p_command->first_index = (u32)((u64)offsets[i] / sizeof(u32));
+            p_command->base_vertex = 0; // Indices are rebased already
+            p_command->base_instance = i_draw;
+        }
+    }
+
+    if (command_count > 0) {
+        u32 commands_offset = uniform_ring_push(p_ring, commands, command_count * sizeof(drawcommand_t));
+        if (gl_state_bind_vao(p_pool->vao)) p_stats->vao_switch_count++;
+        glBindVertexBuffer(GEOMETRY_POOL_DRAW_BINDING, p_ring->buffer, draws_offset, (GLsizei)sizeof(pooldraw_t));
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, p_ring->buffer);
+        glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, (void*)(u64)commands_offset, command_count, 0);
+        p_stats->draw_count++;
+        p_stats->multi_draw_command_count += command_count;
+    }
+    arena_pop_to(scratch, scratch_mark);
+    return i_end;
+}
+
+void render_queue_submit(renderqueue_t* p_queue, texturecache_t* texture_cache, uniformring_t* p_ring, cameradata_t* p_cull_camera, renderstats_t* p_stats) {
+    // Runs of pooled meshes go out as multi draws, everything else a draw at a time
+    u32 i = 0;
+    while (i < p_queue->count) {
+        renderpacket_t* p_packet = &p_queue->packets[p_queue->keys[i].i_packet];
+        if (gl_state_use_program(p_packet->program)) p_stats->program_switch_count++;
+        if (p_packet->p_go->p_pool != NULL) {
+            i = render_pool_draw(p_queue, i, texture_cache, p_ring, p_cull_camera, p_stats);
+            continue;
+        }
+        render_draw_go(p_packet->p_go, texture_cache, p_ring, p_cull_camera, (mat44*)p_packet->model, p_stats);
+        i++;
+    }
 }
 
 void ui_init(ui_t* ui) {
     ui->shader = create_shader("src/shader_ui_vert.glsl", "src/shader_ui_frag.glsl");
-    glUseProgram(ui->shader);
-    glUniform1i(glGetUniformLocation(ui->shader, "u_texture_ui"), 0);
+    gl_state_use_program(ui->shader);
+    i32 texture_location = glGetUniformLocation(ui->shader, "u_texture_ui"); // Not nested, both calls are counted
+    glUniform1i(texture_location, 0);
 
-    u8* font_bytes = (u8*)read_entire_file("Consolas.ttf");
+    filemap_t font_file = read_entire_file("Consolas.ttf");
+    u8* font_bytes = font_file.data;
     u8* font_bitmap = malloc(FONT_ATLAS_WIDTH * FONT_ATLAS_HEIGHT * sizeof(u8));
     stbtt_BakeFontBitmap((u8*)font_bytes, 0, FONT_TEXT_HEIGHT_PIXELS, font_bitmap, FONT_ATLAS_WIDTH, FONT_ATLAS_HEIGHT, ' ', FONT_CHAR_COUNT, ui->font_char_data);
 
@@ -212,7 +1188,7 @@ void ui_init(ui_t* ui) {
     ui->text_scale = stbtt_ScaleForPixelHeight(&font_info, FONT_TEXT_HEIGHT_PIXELS);
 
     glGenTextures(1, &(ui->font_bitmap_handle));
-    glBindTexture(GL_TEXTURE_2D, ui->font_bitmap_handle);
+    gl_state_bind_texture(0, GL_TEXTURE_2D, ui->font_bitmap_handle);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
@@ -220,7 +1196,7 @@ void ui_init(ui_t* ui) {
 
     glTexImage2D(GL_TEXTURE_2D, 0, GL_RED, FONT_ATLAS_WIDTH, FONT_ATLAS_HEIGHT, 0, GL_RED, GL_UNSIGNED_BYTE, font_bitmap);
 
-    free(font_bytes);
+    unmap_file(&font_file);
     free(font_bitmap);
 }
 
@@ -314,7 +1290,7 @@ void ui_create_text_static(uitext_t* ui_text, ui_t* ui, char* text_content, vec2
 
     glGenVertexArrays(1, &(ui_text->vao));
     glGenBuffers(1, &(ui_text->vbo));
-    glBindVertexArray(ui_text->vao);
+    gl_state_bind_vao(ui_text->vao);
 
     glBindBuffer(GL_ARRAY_BUFFER, ui_text->vbo);
     glBufferData(GL_ARRAY_BUFFER, ui_text->vertex_count * 4 * sizeof(float), text_buffer, GL_STATIC_DRAW);
@@ -325,12 +1301,363 @@ void ui_create_text_static(uitext_t* ui_text, ui_t* ui, char* text_content, vec2
     glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void *)(2 * sizeof(float)));
 
     glBindBuffer(GL_ARRAY_BUFFER, 0);
-    glBindVertexArray(0);
+    gl_state_bind_vao(0);
     free(text_buffer);
 }
 
-int main(void) {
+void bench_lod(GLFWwindow* window, gameobject_t* gos, u32 go_count, texturecache_t* texture_cache, u32 world_shader, uniformring_t* p_ring, renderqueue_t* p_queue, bool cull_meshlets, bool sort_draws) {
+    // Copies of the scene in rows running away from the camera, drawn with every mesh at full detail, then with LODs
+    while (texture_cache->pending_count > 0) {
+        texture_cache_poll(texture_cache);
+    }
+
+    float scene_radius = 0;
+    for (u32 i = 0; i < go_count; i++) {
+        vec3 center = { gos[i].bounds[0], gos[i].bounds[1], gos[i].bounds[2] };
+        scene_radius = fmaxf(scene_radius, sqrtf(v3_dot(center, center)) + gos[i].bounds[3]);
+    }
+    float spacing = scene_radius * 2.5f;
+    float far = spacing * (LOD_BENCH_ROWS + 2);
+
+    vec3 eye = { 0, scene_radius, spacing };
+    vec3 center = v3_add(eye, v3_forward);
+    mat44 view = look_at(eye, center, v3_up);
+    mat44 proj = perspective(45.0f, (float)SCREEN_WIDTH / (float)SCREEN_HEIGHT, 0.01f, far);
+    float lod_scale = proj.data[1 * 4 + 1] * SCREEN_HEIGHT * 0.5f;
+    cameradata_t camera = render_camera(&view, &proj, eye);
+    glfwSwapInterval(0);
+
+    // Each copy keeps its own LOD state
+    u32 copy_count = LOD_BENCH_COLUMNS * LOD_BENCH_ROWS;
+    gameobject_t* copies = malloc(copy_count * go_count * sizeof(gameobject_t));
+    printf("lod bench: %u copies of %u meshes, %.1f units apart\n", copy_count, go_count, spacing);
+    for (u32 use_lods = 0; use_lods < 2; use_lods++) {
+        for (u32 i = 0; i < copy_count; i++) {
+            memcpy(&copies[i * go_count], gos, go_count * sizeof(gameobject_t));
+        }
+
+        double frame_seconds = 0;
+        u64 triangle_count = 0;
+        renderstats_t total_stats = { 0 }; // Of the last frame
+        u32 lod_histogram[MESH_MAX_LODS] = { 0 };
+        for (u32 frame = 0; frame < LOD_BENCH_WARMUP_FRAMES + LOD_BENCH_FRAMES; frame++) {
+            double start = glfwGetTime();
+            glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
+            glClear(GL_DEPTH_BUFFER_BIT | GL_COLOR_BUFFER_BIT);
+
+            renderstats_t stats = { 0 };
+            u32 state_issued_start = gl_state.issued_count;
+            u32 state_skipped_start = gl_state.skipped_count;
+            uniform_ring_begin_frame(p_ring, &camera);
+            render_queue_begin(p_queue, eye, far);
+            for (u32 i = 0; i < copy_count; i++) {
+                vec3 position = { ((i % LOD_BENCH_COLUMNS) - (LOD_BENCH_COLUMNS - 1) * 0.5f) * spacing, 0, -(float)(i / LOD_BENCH_COLUMNS) * spacing };
+                mat44 model = mat44_identity;
+                model.data[3 * 4 + 0] = position.x;
+                model.data[3 * 4 + 1] = position.y;
+                model.data[3 * 4 + 2] = position.z;
+                for (u32 j = 0; j < go_count; j++) {
+                    gameobject_t* p_go = &copies[i * go_count + j];
+                    if (use_lods) render_select_lod(p_go, position, eye, lod_scale);
+                    render_queue_push(p_queue, p_go, world_shader, texture_cache, &model);
+                }
+            }
+            if (sort_draws) render_queue_sort(p_queue);
+            render_queue_submit(p_queue, texture_cache, p_ring, cull_meshlets ? &camera : NULL, &stats);
+            uniform_ring_end_frame(p_ring, &stats);
+            stats.state_calls_issued = gl_state.issued_count - state_issued_start;
+            stats.state_calls_skipped = gl_state.skipped_count - state_skipped_start;
+            glFinish(); // Otherwise only the submission is timed
+
+            if (frame >= LOD_BENCH_WARMUP_FRAMES) {
+                frame_seconds += glfwGetTime() - start;
+                triangle_count += stats.triangle_count;
+            }
+            total_stats = stats;
+            glfwSwapBuffers(window);
+            glfwPollEvents();
+        }
+        for (u32 i = 0; i < copy_count * go_count; i++) {
+            lod_histogram[copies[i].current_lod]++;
+        }
+
+        printf("  %s: %.2f ms, %.0f triangles per frame, meshes per level: %u %u %u %u\n", use_lods ? "lods" : "full",
+                frame_seconds * 1000.0 / LOD_BENCH_FRAMES, (double)triangle_count / LOD_BENCH_FRAMES,
+                lod_histogram[0], lod_histogram[1], lod_histogram[2], lod_histogram[3]);
+        printf("    %u draws, switches: %u program, %u texture, %u vao\n", total_stats.draw_count,
+                total_stats.program_switch_count, total_stats.texture_bind_count, total_stats.vao_switch_count);
+        printf("    state calls: %u issued, %u skipped\n", total_stats.state_calls_issued, total_stats.state_calls_skipped);
+        if (total_stats.meshlet_count > 0) {
+            printf("    meshlets: %u of %u culled (%.1f%%), %u vertex shader runs saved\n", total_stats.meshlet_culled_count, total_stats.meshlet_count,
+                    100.0 * total_stats.meshlet_culled_count / total_stats.meshlet_count, total_stats.culled_vertex_count);
+        }
+    }
+    free(copies);
+}
+
+void bench_instancing(GLFWwindow* window, texturecache_t* texture_cache, u32 world_shader, uniformring_t* p_ring, renderqueue_t* p_queue, bool compact_vertices) {
+    // A block of cubes drawn with an instanced draw per mesh, then part of it with a draw per mesh and cube to compare
+    mesh_t* meshes;
+    u32 mesh_count = 0;
+    filemap_t mesh_cache_map = { 0 };
+    arena_t mesh_arena = arena_create(ARENA_RESERVE_SIZE);
+    load_obj_meshes("models/cube.obj", &meshes, &mesh_count, &mesh_cache_map, &mesh_arena);
+    gameobject_t* gos = calloc(mesh_count, sizeof(gameobject_t));
+    for (u32 i = 0; i < mesh_count; i++) {
+        render_create_buffer(&gos[i], &meshes[i], texture_cache, compact_vertices, NULL);
+    }
+    unmap_file(&mesh_cache_map);
+    arena_destroy(&mesh_arena);
+    while (texture_cache->pending_count > 0) {
+        texture_cache_poll(texture_cache);
+    }
+
+    instancedata_t* instances = malloc(INSTANCE_BENCH_COUNT * sizeof(instancedata_t));
+    for (u32 i = 0; i < INSTANCE_BENCH_COUNT; i++) {
+        mat44 model = mat44_identity;
+        model.data[3 * 4 + 0] = ((i % INSTANCE_BENCH_SIDE) - (INSTANCE_BENCH_SIDE - 1) * 0.5f) * INSTANCE_BENCH_SPACING;
+        model.data[3 * 4 + 1] = (((i / INSTANCE_BENCH_SIDE) % INSTANCE_BENCH_SIDE) - (INSTANCE_BENCH_SIDE - 1) * 0.5f) * INSTANCE_BENCH_SPACING;
+        model.data[3 * 4 + 2] = -(float)(i / (INSTANCE_BENCH_SIDE * INSTANCE_BENCH_SIDE)) * INSTANCE_BENCH_SPACING;
+        memcpy(instances[i].model, model.data, sizeof(instances[i].model));
+    }
+    gameobject_t* singles = malloc(mesh_count * sizeof(gameobject_t)); // Same meshes, a draw per cube
+    for (u32 j = 0; j < mesh_count; j++) {
+        // Layers are known once the textures are loaded. Cubes take their layers from each other's
+        // meshes where they share a texture array, so the materials vary across instances
+        texture_t* p_texture = &texture_cache->entries[gos[j].texture_id];
+        for (u32 i = 0; i < INSTANCE_BENCH_COUNT; i++) {
+            texture_t* p_other = &texture_cache->entries[gos[(i + j) % mesh_count].texture_id];
+            instances[i].layer = (i32)((p_other->handle == p_texture->handle) ? p_other->layer : p_texture->layer);
+        }
+        singles[j] = gos[j];
+        render_create_instances(&gos[j], instances, INSTANCE_BENCH_COUNT);
+    }
+
+    float side = INSTANCE_BENCH_SIDE * INSTANCE_BENCH_SPACING;
+    vec3 eye = { 0, 0, side * 1.25f };
+    vec3 center = v3_add(eye, v3_forward);
+    mat44 view = look_at(eye, center, v3_up);
+    float far = eye.z + (float)INSTANCE_BENCH_COUNT / (INSTANCE_BENCH_SIDE * INSTANCE_BENCH_SIDE) * INSTANCE_BENCH_SPACING + side;
+    mat44 proj = perspective(45.0f, (float)SCREEN_WIDTH / (float)SCREEN_HEIGHT, 0.01f, far);
+    cameradata_t camera = render_camera(&view, &proj, eye);
+    glfwSwapInterval(0);
+
+    printf("instancing bench: %u cubes of %u meshes\n", INSTANCE_BENCH_COUNT, mesh_count);
+    for (u32 instanced = 0; instanced < 2; instanced++) {
+        u32 cube_count = instanced ? INSTANCE_BENCH_COUNT : INSTANCE_BENCH_DRAW_COUNT;
+        double frame_seconds = 0;
+        renderstats_t stats = { 0 }; // Of the last frame
+        for (u32 frame = 0; frame < INSTANCE_BENCH_WARMUP_FRAMES + INSTANCE_BENCH_FRAMES; frame++) {
+            double start = glfwGetTime();
+            u32 gl_call_start = gl_call_count;
+            glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
+            glClear(GL_DEPTH_BUFFER_BIT | GL_COLOR_BUFFER_BIT);
+
+            stats = (renderstats_t){ 0 };
+            uniform_ring_begin_frame(p_ring, &camera);
+            render_queue_begin(p_queue, eye, far);
+            for (u32 j = 0; j < mesh_count; j++) {
+                if (instanced) {
+                    render_queue_push(p_queue, &gos[j], world_shader, texture_cache, (mat44*)&mat44_identity);
+                    continue;
+                }
+                for (u32 i = 0; i < cube_count; i++) {
+                    render_queue_push(p_queue, &singles[j], world_shader, texture_cache, (mat44*)instances[i].model);
+                }
+            }
+            render_queue_sort(p_queue);
+            render_queue_submit(p_queue, texture_cache, p_ring, NULL, &stats);
+            uniform_ring_end_frame(p_ring, &stats);
+            stats.gl_call_count = gl_call_count - gl_call_start;
+            glFinish(); // Otherwise only the submission is timed
+
+            if (frame >= INSTANCE_BENCH_WARMUP_FRAMES) frame_seconds += glfwGetTime() - start;
+            glfwSwapBuffers(window);
+            glfwPollEvents();
+        }
+
+        double frame_ms = frame_seconds * 1000.0 / INSTANCE_BENCH_FRAMES;
+        printf("  %s: %u cubes, %.2f ms, %.1f ns per cube\n", instanced ? "instanced" : "draw per cube", cube_count,
+                frame_ms, frame_ms * 1000000.0 / cube_count);
+        printf("    %u draws, %u triangles, %u GL calls, %u bytes of uniforms\n", stats.draw_count, stats.triangle_count,
+                stats.gl_call_count, stats.uniform_bytes);
+    }
+
+    for (u32 i = 0; i < mesh_count; i++) {
+        render_delete_go(&gos[i], texture_cache);
+    }
+    free(singles);
+    free(gos);
+    free(instances);
+}
+
+void bench_multi_draw(GLFWwindow* window, texturecache_t* texture_cache, u32 world_shader, bool compact_vertices, bool sort_draws) {
+    // Fields of 10 to MULTI_DRAW_BENCH_MAX_OBJECTS objects, each one of the scene's meshes, drawn from
+    // buffers of their own with a draw each, then from the geometry pool with multi draws. Times the
+    // CPU side of a frame, from the first push to the end of the submission. Most drivers queue the
+    // work and do it later, so neither the GPU's time nor the driver's deferred cost is in the numbers
+    mesh_t* meshes;
+    u32 mesh_count = 0;
+    filemap_t mesh_cache_map = { 0 };
+    arena_t mesh_arena = arena_create(ARENA_RESERVE_SIZE);
+    load_obj_meshes("models/test_lighting.obj", &meshes, &mesh_count, &mesh_cache_map, &mesh_arena);
+    geometrypool_t pool = { 0 };
+    u32 pool_vertex_count = 0;
+    u32 pool_index_count = 0;
+    for (u32 i = 0; i < mesh_count; i++) {
+        pool_vertex_count += meshes[i].vertex_count;
+        pool_index_count += meshes[i].index_count;
+    }
+    render_pool_create(&pool, pool_vertex_count, pool_index_count, compact_vertices);
+    gameobject_t* gos = calloc(mesh_count * 2, sizeof(gameobject_t)); // Own buffers, then pooled
+    for (u32 i = 0; i < mesh_count; i++) {
+        render_create_buffer(&gos[i], &meshes[i], texture_cache, compact_vertices, NULL);
+        render_create_buffer(&gos[mesh_count + i], &meshes[i], texture_cache, compact_vertices, &pool);
+    }
+    unmap_file(&mesh_cache_map);
+    arena_destroy(&mesh_arena);
+    while (texture_cache->pending_count > 0) {
+        texture_cache_poll(texture_cache);
+    }
+
+    // Big enough for every object with its own uniforms
+    uniformring_t ring = { 0 };
+    uniform_ring_create(&ring, MULTI_DRAW_BENCH_RING_FRAME_SIZE);
+    renderqueue_t queue = { 0 };
+    render_queue_create(&queue, MULTI_DRAW_BENCH_MAX_OBJECTS);
+
+    float scene_radius = 0;
+    for (u32 i = 0; i < mesh_count; i++) {
+        vec3 center = { gos[i].bounds[0], gos[i].bounds[1], gos[i].bounds[2] };
+        scene_radius = fmaxf(scene_radius, sqrtf(v3_dot(center, center)) + gos[i].bounds[3]);
+    }
+    u32 side = (u32)ceilf(sqrtf((float)MULTI_DRAW_BENCH_MAX_OBJECTS));
+    float spacing = scene_radius * 2.5f;
+    mat44* models = malloc(MULTI_DRAW_BENCH_MAX_OBJECTS * sizeof(mat44));
+    for (u32 i = 0; i < MULTI_DRAW_BENCH_MAX_OBJECTS; i++) {
+        models[i] = mat44_identity;
+        models[i].data[3 * 4 + 0] = ((i % side) - (side - 1) * 0.5f) * spacing;
+        models[i].data[3 * 4 + 2] = -(float)(i / side) * spacing;
+    }
+    float far = spacing * (side + 2);
+    vec3 eye = { 0, spacing * side * 0.25f, spacing };
+    vec3 center = v3_add(eye, (vec3){ 0, -0.5f, -1 });
+    mat44 view = look_at(eye, center, v3_up);
+    mat44 proj = perspective(45.0f, (float)SCREEN_WIDTH / (float)SCREEN_HEIGHT, 0.01f, far);
+    cameradata_t camera = render_camera(&view, &proj, eye);
+    glfwSwapInterval(0);
+
+    printf("multi draw bench: %u meshes, CPU submission time per frame only. The GPU and the driver's deferred work aren't measured\n", mesh_count);
+    for (u32 object_count = 10; object_count <= MULTI_DRAW_BENCH_MAX_OBJECTS; object_count *= 100) {
+        for (u32 pooled = 0; pooled < 2; pooled++) {
+            gameobject_t* p_gos = &gos[pooled ? mesh_count : 0];
+            double submit_seconds = 0;
+            renderstats_t stats = { 0 }; // Of the last frame
+            for (u32 frame = 0; frame < MULTI_DRAW_BENCH_WARMUP_FRAMES + MULTI_DRAW_BENCH_FRAMES; frame++) {
+                glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
+                glClear(GL_DEPTH_BUFFER_BIT | GL_COLOR_BUFFER_BIT);
+
+                double start = glfwGetTime();
+                u32 gl_call_start = gl_call_count;
+                stats = (renderstats_t){ 0 };
+                uniform_ring_begin_frame(&ring, &camera);
+                render_queue_begin(&queue, eye, far);
+                for (u32 i = 0; i < object_count; i++) {
+                    render_queue_push(&queue, &p_gos[i % mesh_count], world_shader, texture_cache, &models[i]);
+                }
+                if (sort_draws) render_queue_sort(&queue);
+                render_queue_submit(&queue, texture_cache, &ring, &camera, &stats);
+                uniform_ring_end_frame(&ring, &stats);
+                stats.gl_call_count = gl_call_count - gl_call_start;
+                if (frame >= MULTI_DRAW_BENCH_WARMUP_FRAMES) submit_seconds += glfwGetTime() - start;
+
+                glFinish(); // Frames don't pile up, the GPU's time isn't counted
+                glfwSwapBuffers(window);
+                glfwPollEvents();
+            }
+            printf("  %6u objects, %s: %.3f ms CPU, %u draws, %u GL calls, %u bytes of uniforms\n", object_count,
+                    pooled ? "pooled multi draw" : "draw per object", submit_seconds * 1000.0 / MULTI_DRAW_BENCH_FRAMES,
+                    stats.draw_count, stats.gl_call_count, stats.uniform_bytes);
+        }
+    }
+
+    for (u32 i = 0; i < mesh_count * 2; i++) {
+        render_delete_go(&gos[i], texture_cache);
+    }
+    render_pool_destroy(&pool);
+    uniform_ring_destroy(&ring);
+    render_queue_destroy(&queue);
+    free(models);
+    free(gos);
+}
+
+bool has_flag(int argc, char** argv, char* flag) {
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], flag) == 0) return true;
+    }
+    return false;
+}
+
+int main(int argc, char** argv) {
+    if (argc > 1 && strcmp(argv[1], "--bake-textures") == 0) {
+        bake_textures("textures");
+        return 0;
+    }
+    if (argc > 1 && strcmp(argv[1], "--build-pack") == 0) {
+        return build_pack("assets.p7pack", !(argc > 2 && strcmp(argv[2], "--uncompressed") == 0)) ? 0 : 1;
+    }
+    if (argc > 1 && strcmp(argv[1], "--mesh-report") == 0) {
+        glfwInit(); // For the timer
+        report_obj_meshes("models");
+        glfwTerminate();
+        return 0;
+    }
+    if (argc > 1 && strcmp(argv[1], "--bench-floats") == 0) {
+        glfwInit(); // For the timer
+        bench_parse_float();
+        glfwTerminate();
+        return 0;
+    }
+    if (argc > 1 && strcmp(argv[1], "--bench-obj") == 0) {
+        glfwInit(); // For the timer
+        bench_parse_obj((argc > 2) ? argv[2] : "models/test_lighting.obj");
+        glfwTerminate();
+        return 0;
+    }
+    if (argc > 1 && strcmp(argv[1], "--bench-load") == 0) {
+        glfwInit(); // For the timer
+        bench_load_obj((argc > 2) ? argv[2] : "models/test_lighting.obj");
+        glfwTerminate();
+        return 0;
+    }
+    if (argc > 1 && strcmp(argv[1], "--check-assets") == 0) {
+        // Exit code is the number of failed checks
+        glfwInit(); // For the timer
+        int failed_count = 0;
+        failed_count += !check_parse_float();
+        failed_count += !check_obj_usemtl_groups();
+        failed_count += !check_obj_parallel_parse();
+        failed_count += !check_obj_streaming_memory();
+        glfwTerminate();
+        return failed_count;
+    }
+    if (argc > 1 && strcmp(argv[1], "--bench-pack") == 0) {
+        glfwInit(); // For the timer
+        bench_pack();
+        glfwTerminate();
+        return 0;
+    }
+    bool no_texture_arrays = has_flag(argc, argv, "--no-texture-arrays"); // One array per texture, to compare
+    bool float_vertices = has_flag(argc, argv, "--float-vertices"); // Full size vertices, to compare
+    bool lod_bench = has_flag(argc, argv, "--bench-lod"); // Draws a field of copies and quits
+    bool instancing_bench = has_flag(argc, argv, "--bench-instancing"); // Draws a block of cubes and quits
+    bool cull_meshlets = !has_flag(argc, argv, "--no-meshlet-culling"); // To compare
+    bool sort_draws = !has_flag(argc, argv, "--no-draw-sorting"); // Draws go in the order they're pushed
+    bool use_geometry_pool = !has_flag(argc, argv, "--no-geometry-pool"); // Buffers and a draw per mesh, to compare
+    bool multi_draw_bench = has_flag(argc, argv, "--bench-multi-draw"); // Draws fields of objects both ways and quits
+
     glfwInit();
+    vfs_mount("assets.p7pack"); // Loose files otherwise
 
     GLFWwindow* window = glfwCreateWindow(SCREEN_WIDTH, SCREEN_HEIGHT, "Let's go", NULL, NULL);
     glfwMakeContextCurrent(window);
@@ -339,6 +1666,7 @@ int main(void) {
     // Needs to be after making the gl context current
     // https://gamedev.stackexchange.com/a/73889/81738
     glewInit(); 
+    gl_state_init();
 
     // Another example: https://github.com/shreyaspranav/stb-truetype-example/blob/main/Main.cpp
     ui_t ui = { 0 };
@@ -349,31 +1677,54 @@ int main(void) {
     vec2 text_scale_pixels = { 100, 100 };
     ui_create_text_static(&ui_text, &ui, "a", text_anchor_pixels, text_scale_pixels);
 
-    glEnable(GL_DEPTH_TEST);
-    glEnable(GL_CULL_FACE);
-    glCullFace(GL_BACK);
-    glEnable(GL_BLEND);
-    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    gl_state_set_enabled(GL_DEPTH_TEST, true);
+    gl_state_set_enabled(GL_CULL_FACE, true);
+    gl_state_cull_face(GL_BACK);
+    gl_state_set_enabled(GL_BLEND, true);
+    gl_state_blend_func(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
     mesh_t* meshes;
     u32 mesh_count = 0;
-    read_obj_file("models/test_lighting.obj", &meshes, &mesh_count);
+    filemap_t mesh_cache_map = { 0 };
+    arena_t mesh_arena = arena_create(ARENA_RESERVE_SIZE);
+    load_obj_meshes("models/test_lighting.obj", &meshes, &mesh_count, &mesh_cache_map, &mesh_arena);
 
 #define GOS_MAX 10
     gameobject_t gos[GOS_MAX] = { 0 };
+    texturecache_t texture_cache = { 0 };
+    texture_cache_init(&texture_cache, !no_texture_arrays);
     assert(mesh_count < GOS_MAX);
+    geometrypool_t geometry_pool = { 0 };
+    if (use_geometry_pool) {
+        u32 pool_vertex_count = 0;
+        u32 pool_index_count = 0;
+        for (u32 i = 0; i < mesh_count; i++) {
+            pool_vertex_count += meshes[i].vertex_count;
+            pool_index_count += meshes[i].index_count;
+        }
+        render_pool_create(&geometry_pool, pool_vertex_count, pool_index_count, !float_vertices);
+    }
+    u64 vertex_bytes = 0;
     for (u32 i = 0; i < mesh_count; i++) {
-        render_create_buffer(&(gos[i]), &(meshes[i]));
+        render_create_buffer(&(gos[i]), &(meshes[i]), &texture_cache, !float_vertices, use_geometry_pool ? &geometry_pool : NULL); // Textures are decoded in the background
+        vertex_bytes += meshes[i].vertex_count * (float_vertices ? MESH_VERTEX_SIZE : MESH_COMPACT_VERTEX_SIZE);
     }
+    printf("vertex data: %.1f KB\n", vertex_bytes / 1024.0);
+    unmap_file(&mesh_cache_map); // Cached meshes point into it
+    arena_destroy(&mesh_arena); // Everything's on the GPU now
 
     // Paths need to be relative to the working directory
     // https://stackoverflow.com/a/24597194/4894526
     u32 world_shader = create_shader("src/shader_world_vert.glsl", "src/shader_world_frag.glsl");
-    glUseProgram(world_shader);
-    glUniform1i(glGetUniformLocation(world_shader, "u_tex"), 0);
+    gl_state_use_program(world_shader);
+    i32 texture_location = glGetUniformLocation(world_shader, "u_tex");
+    glUniform1i(texture_location, 0);
+    uniformring_t uniform_ring = { 0 };
+    uniform_ring_create(&uniform_ring, UNIFORM_RING_FRAME_SIZE);
+    renderqueue_t render_queue = { 0 };
+    render_queue_create(&render_queue, RENDER_QUEUE_CAPACITY);
 
     mat44 model = mat44_identity;
-    glUniformMatrix4fv(glGetUniformLocation(world_shader, "u_model"), 1, GL_FALSE, model.data);
 
     vec3 eye = { 0.0f, 0.0f, 2 };
     vec3 up = { 0, 1, 0 };
@@ -382,10 +1733,22 @@ int main(void) {
     vec3 center = v3_add(eye, eye_forward);
     vec3 eye_right = v3_cross(eye_forward, v3_up);
     mat44 view = look_at(eye, center, up);
-    glUniformMatrix4fv(glGetUniformLocation(world_shader, "u_view"), 1, GL_FALSE, view.data);
+    float far = 100.0f;
+    mat44 proj = perspective(45.0f, (float)SCREEN_WIDTH / (float)SCREEN_HEIGHT, 0.01f, far);
+    float lod_scale = proj.data[1 * 4 + 1] * SCREEN_HEIGHT * 0.5f; // Pixels per unit at a distance of 1
 
-    mat44 proj = perspective(45.0f, (float)SCREEN_WIDTH / (float)SCREEN_HEIGHT, 0.01f, 100.0f);
-    glUniformMatrix4fv(glGetUniformLocation(world_shader, "u_proj"), 1, GL_FALSE, proj.data);
+    if (lod_bench) {
+        bench_lod(window, gos, mesh_count, &texture_cache, world_shader, &uniform_ring, &render_queue, cull_meshlets, sort_draws);
+        glfwSetWindowShouldClose(window, true);
+    }
+    if (instancing_bench) {
+        bench_instancing(window, &texture_cache, world_shader, &uniform_ring, &render_queue, !float_vertices);
+        glfwSetWindowShouldClose(window, true);
+    }
+    if (multi_draw_bench) {
+        bench_multi_draw(window, &texture_cache, world_shader, !float_vertices, sort_draws);
+        glfwSetWindowShouldClose(window, true);
+    }
 
     float time = (float)glfwGetTime();
 
@@ -394,6 +1757,8 @@ int main(void) {
     float prev_mouse_x = (float)temp_prev_mouse_x;
     float prev_mouse_y = (float)temp_prev_mouse_y;
 
+    bool first_frame_shown = false;
+    bool textures_loaded = false;
     while (!glfwWindowShouldClose(window)) {
 
         float dt = (float)glfwGetTime() - time;
@@ -450,42 +1815,77 @@ int main(void) {
         //mat44 rotate = euler_to_rot(rotate_euler);
         //model = mat44_mul(&model, &rotate);
 
-        glUseProgram(world_shader);
-        glUniformMatrix4fv(glGetUniformLocation(world_shader, "u_view"), 1, GL_FALSE, view.data);
-        glUniformMatrix4fv(glGetUniformLocation(world_shader, "u_model"), 1, GL_FALSE, model.data);
+        texture_cache_poll(&texture_cache);
 
+        u32 frame_gl_call_start = gl_call_count; // Texture uploads aside
+        u32 frame_state_issued_start = gl_state.issued_count;
+        u32 frame_state_skipped_start = gl_state.skipped_count;
         glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
         glClear(GL_DEPTH_BUFFER_BIT | GL_COLOR_BUFFER_BIT);
 
-        glUseProgram(world_shader);
-
+        cameradata_t camera = render_camera(&view, &proj, eye);
+        renderstats_t frame_stats = { 0 };
+        uniform_ring_begin_frame(&uniform_ring, &camera);
+        render_queue_begin(&render_queue, eye, far);
         for (u32 i = 0; i < GOS_MAX; i++) {
             if (gos[i].vao == 0) continue;
-            render_draw_go(&gos[i]);
+            render_select_lod(&gos[i], (vec3){ 0 }, eye, lod_scale);
+            render_queue_push(&render_queue, &gos[i], world_shader, &texture_cache, &model);
         }
+        if (sort_draws) render_queue_sort(&render_queue);
+        render_queue_submit(&render_queue, &texture_cache, &uniform_ring, cull_meshlets ? &camera : NULL, &frame_stats);
+        uniform_ring_end_frame(&uniform_ring, &frame_stats);
 
-        glUseProgram(ui.shader);
-        glBindVertexArray(ui_text.vao);
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, ui.font_bitmap_handle);
+        gl_state_use_program(ui.shader);
+        gl_state_bind_vao(ui_text.vao);
+        gl_state_bind_texture(0, GL_TEXTURE_2D, ui.font_bitmap_handle);
         glDrawArrays(GL_TRIANGLES, 0, ui_text.vertex_count);
+        frame_stats.gl_call_count = gl_call_count - frame_gl_call_start;
+        frame_stats.state_calls_issued = gl_state.issued_count - frame_state_issued_start;
+        frame_stats.state_calls_skipped = gl_state.skipped_count - frame_state_skipped_start;
 
         glfwSwapBuffers(window);
         glfwPollEvents();
+
+        // glfw's timer starts at glfwInit
+        if (!first_frame_shown) {
+            first_frame_shown = true;
+            printf("first frame: %.2f ms\n", glfwGetTime() * 1000.0);
+        }
+        if (!textures_loaded && texture_cache.pending_count == 0) {
+            textures_loaded = true;
+            printf("fully loaded: %.2f ms\n", glfwGetTime() * 1000.0);
+            texture_print_stats(&texture_cache);
+            vfs_print_stats();
+            printf("per frame: %u draws (%u multi draw commands), %u triangles, %u GL calls, %u bytes of uniforms\n", frame_stats.draw_count,
+                    frame_stats.multi_draw_command_count, frame_stats.triangle_count, frame_stats.gl_call_count, frame_stats.uniform_bytes);
+            printf("state switches: %u program, %u texture, %u vao\n", frame_stats.program_switch_count,
+                    frame_stats.texture_bind_count, frame_stats.vao_switch_count);
+            printf("state calls: %u issued, %u skipped\n", frame_stats.state_calls_issued, frame_stats.state_calls_skipped);
+            if (frame_stats.meshlet_count > 0) {
+                printf("meshlets: %u of %u culled (%.1f%%), %u vertex shader runs saved\n", frame_stats.meshlet_culled_count, frame_stats.meshlet_count,
+                        100.0 * frame_stats.meshlet_culled_count / frame_stats.meshlet_count, frame_stats.culled_vertex_count);
+            }
+        }
     }
 
     glDeleteProgram(world_shader);
+    uniform_ring_destroy(&uniform_ring);
+    render_queue_destroy(&render_queue);
 
     for (u32 i = 0; i < GOS_MAX; i++) {
         if (gos[i].vao == 0) continue;
-        render_delete_go(&gos[i]);
+        render_delete_go(&gos[i], &texture_cache);
     }
+    if (use_geometry_pool) render_pool_destroy(&geometry_pool);
+    texture_cache_destroy(&texture_cache);
 
-    glDeleteVertexArrays(1, &(ui_text.vao));
+    gl_state_delete_vao(&(ui_text.vao));
     glDeleteBuffers(1, &(ui_text.vbo));
     glDeleteProgram(ui.shader);
-    glDeleteTextures(1, &ui.font_bitmap_handle);
+    gl_state_delete_texture(&ui.font_bitmap_handle);
 
+    vfs_unmount();
     glfwTerminate();
 
     return 0;
@@ -0,0 +1,826 @@
+// Mesh optimization, run on indexed meshes before they're cached and uploaded.
+// Triangles are reordered for the post-transform vertex cache with Tipsify
+// (Sander, Nehab, Barczak 2007), the resulting clusters are sorted so the
+// outward facing ones draw first (less overdraw), then vertices are renumbered
+// in first-use order so the vertex fetch walks the buffer front to back
+
+u32 mesh_get_index(mesh_t* p_mesh, u32 i) {
+    if (p_mesh->index_size == 2) return ((u16*)p_mesh->index_data)[i];
+    return ((u32*)p_mesh->index_data)[i];
+}
+
+void mesh_set_index(mesh_t* p_mesh, u32 i, u32 index) {
+    if (p_mesh->index_size == 2) ((u16*)p_mesh->index_data)[i] = (u16)index;
+    else ((u32*)p_mesh->index_data)[i] = index;
+}
+
+u32 mesh_count_cache_misses(mesh_t* p_mesh, u32 cache_size) {
+    // Simulates a FIFO post-transform cache, which is what most hardware is close to
+    u32 cache[64];
+    assert(cache_size <= 64);
+    u32 cache_count = 0;
+    u32 cache_head = 0;
+    u32 miss_count = 0;
+    for (u32 i = 0; i < p_mesh->index_count; i++) {
+        u32 index = mesh_get_index(p_mesh, i);
+        bool hit = false;
+        for (u32 j = 0; j < cache_count; j++) {
+            if (cache[j] == index) { hit = true; break; }
+        }
+        if (hit) continue;
+
+        miss_count++;
+        if (cache_count < cache_size) {
+            cache[cache_count++] = index;
+        } else {
+            cache[cache_head] = index;
+            cache_head = (cache_head + 1) % cache_size;
+        }
+    }
+    return miss_count;
+}
+
+void mesh_get_cache_stats(mesh_t* p_mesh, float* p_acmr, float* p_atvr) {
+    // Vertex shader runs per triangle (0.5 is ideal on a big grid) and per vertex (1.0 is ideal)
+    u32 miss_count = mesh_count_cache_misses(p_mesh, VERTEX_CACHE_SIZE);
+    *p_acmr = (float)miss_count / (float)(p_mesh->index_count / 3);
+    *p_atvr = (float)miss_count / (float)p_mesh->vertex_count;
+}
+
+u32 mesh_tipsify(mesh_t* p_mesh, u32* result, u32* cluster_starts, arena_t* scratch) {
+    // Fans around one vertex at a time, picking the next one among the vertices
+    // just emitted that will still be in the cache once its triangles are done.
+    // When there's none (a dead end), it restarts from the most recent vertex with
+    // triangles left, which also starts a new cluster. Returns the cluster count
+    u32 vertex_count = p_mesh->vertex_count;
+    u32 triangle_count = p_mesh->index_count / 3;
+    u32 cache_size = VERTEX_CACHE_SIZE;
+
+    // Triangles of each vertex, as offsets into one list
+    u32* live_counts = arena_push(scratch, vertex_count * sizeof(u32)); // Triangles not emitted yet
+    u32* adjacency_offsets = arena_push(scratch, (vertex_count + 1) * sizeof(u32));
+    u32* adjacency = arena_push(scratch, p_mesh->index_count * sizeof(u32));
+    memset(live_counts, 0, vertex_count * sizeof(u32));
+    for (u32 i = 0; i < p_mesh->index_count; i++) {
+        live_counts[mesh_get_index(p_mesh, i)]++;
+    }
+    adjacency_offsets[0] = 0;
+    for (u32 i = 0; i < vertex_count; i++) {
+        adjacency_offsets[i + 1] = adjacency_offsets[i] + live_counts[i];
+    }
+    u32* fill_counts = arena_push(scratch, vertex_count * sizeof(u32));
+    memset(fill_counts, 0, vertex_count * sizeof(u32));
+    for (u32 i = 0; i < p_mesh->index_count; i++) {
+        u32 index = mesh_get_index(p_mesh, i);
+        adjacency[adjacency_offsets[index] + fill_counts[index]++] = i / 3;
+    }
+
+    u32* cache_times = arena_push(scratch, vertex_count * sizeof(u32)); // When the vertex last entered the cache
+    memset(cache_times, 0, vertex_count * sizeof(u32));
+    bool* emitted = arena_push(scratch, triangle_count * sizeof(bool));
+    memset(emitted, 0, triangle_count * sizeof(bool));
+    u32* dead_ends = arena_push(scratch, p_mesh->index_count * sizeof(u32)); // Stack of emitted vertices
+    u32 dead_end_count = 0;
+
+    u32 time = cache_size + 1;
+    u32 cursor = 0; // Sequential scan for when the stack runs out
+    u32 result_count = 0;
+    u32 cluster_count = 0;
+    i32 fanning = -1;
+    while (fanning < 0 && cursor < vertex_count) {
+        if (live_counts[cursor] > 0) fanning = (i32)cursor;
+        cursor++;
+    }
+    bool new_cluster = true;
+    while (fanning >= 0) {
+        if (new_cluster) cluster_starts[cluster_count++] = result_count / 3;
+
+        u32 candidates_start = dead_end_count;
+        for (u32 i = adjacency_offsets[fanning]; i < adjacency_offsets[fanning + 1]; i++) {
+            u32 i_triangle = adjacency[i];
+            if (emitted[i_triangle]) continue;
+            emitted[i_triangle] = true;
+            for (u32 j = 0; j < 3; j++) {
+                u32 index = mesh_get_index(p_mesh, i_triangle * 3 + j);
+                result[result_count++] = index;
+                dead_ends[dead_end_count++] = index;
+                live_counts[index]--;
+                if (time - cache_times[index] > cache_size) {
+                    cache_times[index] = time;
+                    time++;
+                }
+            }
+        }
+
+        // Best candidate is the oldest one that won't be evicted while its triangles are emitted
+        fanning = -1;
+        u32 best_priority = 0;
+        for (u32 i = candidates_start; i < dead_end_count; i++) {
+            u32 index = dead_ends[i];
+            if (live_counts[index] == 0) continue;
+            u32 priority = 1;
+            if (time - cache_times[index] + 2 * live_counts[index] <= cache_size) priority = 2 + time - cache_times[index];
+            if (priority > best_priority) {
+                best_priority = priority;
+                fanning = (i32)index;
+            }
+        }
+        new_cluster = (fanning < 0);
+        while (fanning < 0 && dead_end_count > 0) {
+            u32 index = dead_ends[--dead_end_count];
+            if (live_counts[index] > 0) fanning = (i32)index;
+        }
+        while (fanning < 0 && cursor < vertex_count) {
+            if (live_counts[cursor] > 0) fanning = (i32)cursor;
+            cursor++;
+        }
+    }
+    assert(result_count == p_mesh->index_count);
+    return cluster_count;
+}
+
+int mesh_compare_clusters(const void* a, const void* b) {
+    // Descending
+    float key_a = ((meshcluster_t*)a)->sort_key;
+    float key_b = ((meshcluster_t*)b)->sort_key;
+    return (key_a < key_b) - (key_a > key_b);
+}
+
+void mesh_sort_clusters(mesh_t* p_mesh, u32* indices, u32* cluster_starts, u32 cluster_count, u32* result, arena_t* scratch) {
+    // Clusters facing away from the mesh's center are likely in front of the
+    // rest of it, so they go first: how far the cluster's centroid is from the
+    // mesh's centroid, along the cluster's average normal
+    u32 triangle_count = p_mesh->index_count / 3;
+    vec3 mesh_centroid = { 0 };
+    for (u32 i = 0; i < p_mesh->vertex_count; i++) {
+        mesh_centroid = v3_add(mesh_centroid, *(vec3*)&p_mesh->vertex_data[i * 8]);
+    }
+    mesh_centroid = v3_scale(mesh_centroid, 1.0f / (float)p_mesh->vertex_count);
+
+    meshcluster_t* clusters = arena_push(scratch, cluster_count * sizeof(meshcluster_t));
+    for (u32 i_cluster = 0; i_cluster < cluster_count; i_cluster++) {
+        meshcluster_t* p_cluster = &clusters[i_cluster];
+        p_cluster->first_triangle = cluster_starts[i_cluster];
+        u32 end = (i_cluster + 1 < cluster_count) ? cluster_starts[i_cluster + 1] : triangle_count;
+        p_cluster->triangle_count = end - p_cluster->first_triangle;
+
+        // Area weighted, the cross product's length is twice the area
+        vec3 centroid = { 0 };
+        vec3 normal = { 0 };
+        float area_total = 0.0f;
+        for (u32 i_triangle = p_cluster->first_triangle; i_triangle < end; i_triangle++) {
+            vec3 a = *(vec3*)&p_mesh->vertex_data[indices[i_triangle * 3 + 0] * 8];
+            vec3 b = *(vec3*)&p_mesh->vertex_data[indices[i_triangle * 3 + 1] * 8];
+            vec3 c = *(vec3*)&p_mesh->vertex_data[indices[i_triangle * 3 + 2] * 8];
+            vec3 cross = v3_cross(v3_sub(b, a), v3_sub(c, a));
+            float area = sqrtf(v3_dot(cross, cross));
+            centroid = v3_add(centroid, v3_scale(v3_add(v3_add(a, b), c), area / 3.0f));
+            normal = v3_add(normal, cross);
+            area_total += area;
+        }
+        float normal_length = sqrtf(v3_dot(normal, normal));
+        if (area_total > 0.0f && normal_length > 0.0f) {
+            centroid = v3_scale(centroid, 1.0f / area_total);
+            p_cluster->sort_key = v3_dot(v3_sub(centroid, mesh_centroid), v3_scale(normal, 1.0f / normal_length));
+        } else {
+            p_cluster->sort_key = 0.0f;
+        }
+    }
+
+    qsort(clusters, cluster_count, sizeof(meshcluster_t), mesh_compare_clusters);
+    u32 result_count = 0;
+    for (u32 i = 0; i < cluster_count; i++) {
+        memcpy(&result[result_count], &indices[clusters[i].first_triangle * 3], clusters[i].triangle_count * 3 * sizeof(u32));
+        result_count += clusters[i].triangle_count * 3;
+    }
+}
+
+void mesh_optimize(mesh_t* p_mesh, bool sort_for_overdraw, arena_t* scratch) {
+    // Reorders in place, the mesh keeps its vertex and index counts
+    if (p_mesh->index_count == 0) return;
+    u64 scratch_mark = arena_mark(scratch);
+    u32 triangle_count = p_mesh->index_count / 3;
+
+    u32* indices = arena_push(scratch, p_mesh->index_count * sizeof(u32));
+    u32* cluster_starts = arena_push(scratch, triangle_count * sizeof(u32));
+    u32 cluster_count = mesh_tipsify(p_mesh, indices, cluster_starts, scratch);
+    if (sort_for_overdraw && cluster_count > 1) {
+        u32* sorted = arena_push(scratch, p_mesh->index_count * sizeof(u32));
+        mesh_sort_clusters(p_mesh, indices, cluster_starts, cluster_count, sorted, scratch);
+        indices = sorted;
+    }
+
+    // Vertices are renumbered in the order the new index buffer first uses them
+    u32* remap = arena_push(scratch, p_mesh->vertex_count * sizeof(u32));
+    memset(remap, 0xFF, p_mesh->vertex_count * sizeof(u32)); // 0xFFFFFFFF is not used yet
+    float* vertex_data = arena_push(scratch, p_mesh->vertex_count * 8 * sizeof(float));
+    memcpy(vertex_data, p_mesh->vertex_data, p_mesh->vertex_count * 8 * sizeof(float));
+    u32 next_vertex = 0;
+    for (u32 i = 0; i < p_mesh->index_count; i++) {
+        u32 index = indices[i];
+        if (remap[index] == 0xFFFFFFFF) {
+            remap[index] = next_vertex;
+            memcpy(&p_mesh->vertex_data[next_vertex * 8], &vertex_data[index * 8], 8 * sizeof(float));
+            next_vertex++;
+        }
+        mesh_set_index(p_mesh, i, remap[index]);
+    }
+    assert(next_vertex == p_mesh->vertex_count); // Every vertex comes from a face corner
+
+    arena_pop_to(scratch, scratch_mark);
+}
+
+//
+// Compact vertex format, 14 bytes instead of 32:
+//   position: 3x u16, fraction of the mesh's bounding box
+//   uv:       2x u16, fraction of the mesh's uv range (uvs can tile past 0..1)
+//   normal:   2x snorm16, octahedral
+// shader_world_vert.glsl undoes it with the mesh's "dequant" uniform
+//
+
+void mesh_oct_encode(vec3 n, i16* result) {
+    // Projects onto the octahedron |x| + |y| + |z| = 1, then folds the lower half over the diagonals
+    float l1 = fabsf(n.x) + fabsf(n.y) + fabsf(n.z);
+    float x = (l1 > 0.0f) ? n.x / l1 : 0.0f;
+    float y = (l1 > 0.0f) ? n.y / l1 : 0.0f;
+    if (n.z < 0.0f) {
+        float folded_x = (1.0f - fabsf(y)) * (x >= 0.0f ? 1.0f : -1.0f);
+        float folded_y = (1.0f - fabsf(x)) * (y >= 0.0f ? 1.0f : -1.0f);
+        x = folded_x;
+        y = folded_y;
+    }
+    result[0] = (i16)roundf(fminf(fmaxf(x, -1.0f), 1.0f) * 32767.0f);
+    result[1] = (i16)roundf(fminf(fmaxf(y, -1.0f), 1.0f) * 32767.0f);
+}
+
+vec3 mesh_oct_decode(i16* encoded) {
+    // Same as the shader
+    vec3 n;
+    n.x = fmaxf((float)encoded[0] / 32767.0f, -1.0f);
+    n.y = fmaxf((float)encoded[1] / 32767.0f, -1.0f);
+    n.z = 1.0f - fabsf(n.x) - fabsf(n.y);
+    float t = fmaxf(-n.z, 0.0f);
+    n.x += (n.x >= 0.0f) ? -t : t;
+    n.y += (n.y >= 0.0f) ? -t : t;
+    return v3_norm(n);
+}
+
+void mesh_quantize(mesh_t* p_mesh, u16* result, float* dequant, quanterror_t* p_error) {
+    // "result" gets MESH_COMPACT_VERTEX_SIZE bytes per vertex, "dequant" 12 floats,
+    // "p_error" the largest difference after decoding
+    float min[5] = { FLT_MAX, FLT_MAX, FLT_MAX, FLT_MAX, FLT_MAX }; // Position and uv
+    float max[5] = { -FLT_MAX, -FLT_MAX, -FLT_MAX, -FLT_MAX, -FLT_MAX };
+    for (u32 i = 0; i < p_mesh->vertex_count; i++) {
+        float* vertex = &p_mesh->vertex_data[i * 8];
+        for (u32 j = 0; j < 5; j++) {
+            min[j] = fminf(min[j], vertex[j]);
+            max[j] = fmaxf(max[j], vertex[j]);
+        }
+    }
+
+    // Quantized values are used as they are in the shader, so a step of the grid is the scale
+    float scale[5];
+    for (u32 j = 0; j < 5; j++) {
+        scale[j] = (max[j] > min[j]) ? (max[j] - min[j]) / 65535.0f : 1.0f;
+    }
+    float dequant_values[12] = {
+        min[0], min[1], min[2], 0.0f,
+        scale[0], scale[1], scale[2], 1.0f, // w: normals are octahedral
+        min[3], min[4], scale[3], scale[4],
+    };
+    memcpy(dequant, dequant_values, sizeof(dequant_values));
+
+    memset(p_error, 0, sizeof(quanterror_t));
+    for (u32 i = 0; i < p_mesh->vertex_count; i++) {
+        float* vertex = &p_mesh->vertex_data[i * 8];
+        u16* packed = &result[i * MESH_COMPACT_VERTEX_SIZE / sizeof(u16)];
+        for (u32 j = 0; j < 5; j++) {
+            float q = roundf((vertex[j] - min[j]) / scale[j]);
+            packed[j] = (u16)fminf(fmaxf(q, 0.0f), 65535.0f);
+            float error = fabsf(min[j] + packed[j] * scale[j] - vertex[j]);
+            if (j < 3) p_error->position = fmaxf(p_error->position, error);
+            else p_error->uv = fmaxf(p_error->uv, error);
+        }
+
+        // A missing normal still gets a value, +z, the buffer is uploaded as it is
+        vec3 normal = *(vec3*)&vertex[5];
+        if (v3_iszero(normal)) {
+            mesh_oct_encode((vec3){ 0.0f, 0.0f, 1.0f }, (i16*)&packed[5]);
+            continue;
+        }
+        normal = v3_norm(normal);
+        mesh_oct_encode(normal, (i16*)&packed[5]);
+        float cos_error = fminf(v3_dot(normal, mesh_oct_decode((i16*)&packed[5])), 1.0f);
+        p_error->normal_degrees = fmaxf(p_error->normal_degrees, acosf(cos_error) / DEG2RAD);
+    }
+}
+
+//
+// LOD generation. Edge collapses driven by quadric error metrics (Garland and
+// Heckbert 1997), collapsing a vertex onto a neighbor so the simplified levels
+// reuse the mesh's vertex buffer. Vertices split by a uv or normal seam are
+// moved together, and only where each of their copies has a matching copy on
+// the other side, so seams and hard edges stay in place. All levels are
+// appended to the index buffer, mesh_t.lods says where each one is
+//
+
+void mesh_quadric_add_plane(meshquadric_t* q, vec3 n, float d, float weight) {
+    q->a00 += weight * n.x * n.x;
+    q->a11 += weight * n.y * n.y;
+    q->a22 += weight * n.z * n.z;
+    q->a10 += weight * n.y * n.x;
+    q->a20 += weight * n.z * n.x;
+    q->a21 += weight * n.z * n.y;
+    q->b0 += weight * n.x * d;
+    q->b1 += weight * n.y * d;
+    q->b2 += weight * n.z * d;
+    q->c += weight * d * d;
+    q->weight += weight;
+}
+
+void mesh_quadric_add(meshquadric_t* q, meshquadric_t* other) {
+    float* a = (float*)q;
+    float* b = (float*)other;
+    for (u32 i = 0; i < sizeof(meshquadric_t) / sizeof(float); i++) a[i] += b[i];
+}
+
+float mesh_quadric_error(meshquadric_t* q, vec3 p) {
+    // Weighted sum of squared distances to the planes
+    float rx = q->a00 * p.x + q->a10 * p.y + q->a20 * p.z + 2.0f * q->b0;
+    float ry = q->a10 * p.x + q->a11 * p.y + q->a21 * p.z + 2.0f * q->b1;
+    float rz = q->a20 * p.x + q->a21 * p.y + q->a22 * p.z + 2.0f * q->b2;
+    return fmaxf(rx * p.x + ry * p.y + rz * p.z + q->c, 0.0f);
+}
+
+int mesh_compare_collapses(const void* a, const void* b) {
+    float cost_a = ((meshcollapse_t*)a)->cost;
+    float cost_b = ((meshcollapse_t*)b)->cost;
+    return (cost_a > cost_b) - (cost_a < cost_b);
+}
+
+typedef struct {
+    u32 vertex_count;
+    vec3* positions; // Normalized to the unit cube, so the error math stays in float range
+    u32* groups; // Vertex with the same position that stands for all of them
+    u32* next_in_group; // Circular list of the vertices at the same position
+    meshquadric_t* quadrics; // Per group
+    u32* indices; // Current level
+    u32 index_count;
+    u32* triangle_offsets; // Per vertex, into triangle_lists
+    u32* triangle_lists; // Triangles using each vertex
+    u32* collapsed_to; // Per group, the group it was moved onto, itself while it's still there
+} meshsimplify_t; // Here rather than main.c, it needs vec3
+
+u32 mesh_find_partner(meshsimplify_t* s, u32 vertex, u32 group) {
+    // A vertex in "group" that shares a triangle with "vertex", 0xFFFFFFFF if none
+    for (u32 i = s->triangle_offsets[vertex]; i < s->triangle_offsets[vertex + 1]; i++) {
+        u32* triangle = &s->indices[s->triangle_lists[i] * 3];
+        for (u32 j = 0; j < 3; j++) {
+            if (s->groups[triangle[j]] == group) return triangle[j];
+        }
+    }
+    return 0xFFFFFFFF;
+}
+
+bool mesh_can_collapse(meshsimplify_t* s, u32 from, u32 to) {
+    // Every copy of "from" that's still used needs a partner in "to", and no
+    // triangle that survives the collapse can flip over
+    u32 vertex = from;
+    do {
+        if (s->triangle_offsets[vertex] != s->triangle_offsets[vertex + 1] && mesh_find_partner(s, vertex, to) == 0xFFFFFFFF) return false;
+
+        for (u32 i = s->triangle_offsets[vertex]; i < s->triangle_offsets[vertex + 1]; i++) {
+            u32* triangle = &s->indices[s->triangle_lists[i] * 3];
+            u32 g0 = s->groups[triangle[0]], g1 = s->groups[triangle[1]], g2 = s->groups[triangle[2]];
+            if (g0 == to || g1 == to || g2 == to) continue; // Goes away
+            vec3 p[3] = { s->positions[g0], s->positions[g1], s->positions[g2] };
+            vec3 n_before = v3_cross(v3_sub(p[1], p[0]), v3_sub(p[2], p[0]));
+            if (g0 == from) p[0] = s->positions[to];
+            if (g1 == from) p[1] = s->positions[to];
+            if (g2 == from) p[2] = s->positions[to];
+            vec3 n_after = v3_cross(v3_sub(p[1], p[0]), v3_sub(p[2], p[0]));
+            if (v3_dot(n_before, n_after) < 0.25f * sqrtf(v3_dot(n_before, n_before) * v3_dot(n_after, n_after))) return false;
+        }
+        vertex = s->next_in_group[vertex];
+    } while (vertex != from);
+    return true;
+}
+
+void mesh_build_triangle_lists(meshsimplify_t* s, arena_t* scratch) {
+    memset(s->triangle_offsets, 0, (s->vertex_count + 1) * sizeof(u32));
+    for (u32 i = 0; i < s->index_count; i++) s->triangle_offsets[s->indices[i] + 1]++;
+    for (u32 i = 0; i < s->vertex_count; i++) s->triangle_offsets[i + 1] += s->triangle_offsets[i];
+    u32* fill_counts = arena_push(scratch, s->vertex_count * sizeof(u32));
+    memset(fill_counts, 0, s->vertex_count * sizeof(u32));
+    for (u32 i = 0; i < s->index_count; i++) {
+        u32 vertex = s->indices[i];
+        s->triangle_lists[s->triangle_offsets[vertex] + fill_counts[vertex]++] = i / 3;
+    }
+}
+
+void mesh_lock_ring(meshsimplify_t* s, u32 group, bool* locked) {
+    // Every group sharing a triangle with "group"
+    u32 vertex = group;
+    do {
+        for (u32 i = s->triangle_offsets[vertex]; i < s->triangle_offsets[vertex + 1]; i++) {
+            u32* triangle = &s->indices[s->triangle_lists[i] * 3];
+            for (u32 j = 0; j < 3; j++) locked[s->groups[triangle[j]]] = true;
+        }
+        vertex = s->next_in_group[vertex];
+    } while (vertex != group);
+}
+
+u32 mesh_simplify_pass(meshsimplify_t* s, u32 target_index_count, arena_t* scratch) {
+    // Collapses the cheapest edges whose neighborhoods don't overlap, returns how many it did.
+    // mesh_can_collapse looks at the triangles as they were at the start of the pass, so the
+    // one-rings of both ends are locked after a collapse, nothing it changed gets checked again
+    u64 scratch_mark = arena_mark(scratch);
+    mesh_build_triangle_lists(s, scratch);
+
+    // Both directions of every edge, cost is the mean squared distance to the merged planes
+    u32 collapse_count = 0;
+    meshcollapse_t* collapses = arena_push(scratch, s->index_count * 2 * sizeof(meshcollapse_t));
+    for (u32 i = 0; i < s->index_count; i++) {
+        u32 a = s->groups[s->indices[i]];
+        u32 b = s->groups[s->indices[i - i % 3 + (i + 1) % 3]];
+        if (a == b) continue;
+        for (u32 direction = 0; direction < 2; direction++) {
+            u32 from = direction ? b : a;
+            u32 to = direction ? a : b;
+            float error = mesh_quadric_error(&s->quadrics[from], s->positions[to]) + mesh_quadric_error(&s->quadrics[to], s->positions[to]);
+            float weight = s->quadrics[from].weight + s->quadrics[to].weight;
+            meshcollapse_t collapse = { (weight > 0.0f) ? error / weight : 0.0f, from, to };
+            collapses[collapse_count++] = collapse;
+        }
+    }
+    qsort(collapses, collapse_count, sizeof(meshcollapse_t), mesh_compare_collapses);
+
+    // An interior collapse removes two triangles
+    u32 collapse_limit = (s->index_count - target_index_count) / 6 + 1;
+    u32* remap = arena_push(scratch, s->vertex_count * sizeof(u32));
+    bool* locked = arena_push(scratch, s->vertex_count * sizeof(bool));
+    for (u32 i = 0; i < s->vertex_count; i++) remap[i] = i;
+    memset(locked, 0, s->vertex_count * sizeof(bool));
+    u32 applied_count = 0;
+    for (u32 i = 0; i < collapse_count && applied_count < collapse_limit; i++) {
+        meshcollapse_t* p_collapse = &collapses[i];
+        if (locked[p_collapse->from] || locked[p_collapse->to]) continue;
+        if (!mesh_can_collapse(s, p_collapse->from, p_collapse->to)) continue;
+
+        u32 vertex = p_collapse->from;
+        do {
+            u32 partner = mesh_find_partner(s, vertex, p_collapse->to);
+            if (partner != 0xFFFFFFFF) remap[vertex] = partner;
+            vertex = s->next_in_group[vertex];
+        } while (vertex != p_collapse->from);
+        mesh_quadric_add(&s->quadrics[p_collapse->to], &s->quadrics[p_collapse->from]);
+        s->collapsed_to[p_collapse->from] = p_collapse->to;
+        mesh_lock_ring(s, p_collapse->from, locked);
+        mesh_lock_ring(s, p_collapse->to, locked);
+        applied_count++;
+    }
+
+    // Triangles that lost a corner are dropped
+    u32 index_count = 0;
+    for (u32 i = 0; i < s->index_count; i += 3) {
+        u32 a = remap[s->indices[i]], b = remap[s->indices[i + 1]], c = remap[s->indices[i + 2]];
+        if (a == b || b == c || a == c) continue;
+        s->indices[index_count++] = a;
+        s->indices[index_count++] = b;
+        s->indices[index_count++] = c;
+    }
+    s->index_count = index_count;
+
+    arena_pop_to(scratch, scratch_mark);
+    return applied_count;
+}
+
+float mesh_init_simplify(meshsimplify_t* s, mesh_t* p_mesh, arena_t* scratch) {
+    // Returns the scale from the normalized positions back to model units
+    u32 vertex_count = p_mesh->vertex_count;
+    s->vertex_count = vertex_count;
+    s->index_count = p_mesh->index_count;
+    s->indices = arena_push(scratch, p_mesh->index_count * sizeof(u32));
+    for (u32 i = 0; i < p_mesh->index_count; i++) s->indices[i] = mesh_get_index(p_mesh, i);
+    s->triangle_offsets = arena_push(scratch, (vertex_count + 1) * sizeof(u32));
+    s->triangle_lists = arena_push(scratch, p_mesh->index_count * sizeof(u32));
+    s->collapsed_to = arena_push(scratch, vertex_count * sizeof(u32));
+    for (u32 i = 0; i < vertex_count; i++) s->collapsed_to[i] = i;
+
+    vec3 min = { FLT_MAX, FLT_MAX, FLT_MAX };
+    vec3 max = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+    for (u32 i = 0; i < vertex_count; i++) {
+        float* position = &p_mesh->vertex_data[i * 8];
+        min = (vec3){ fminf(min.x, position[0]), fminf(min.y, position[1]), fminf(min.z, position[2]) };
+        max = (vec3){ fmaxf(max.x, position[0]), fmaxf(max.y, position[1]), fmaxf(max.z, position[2]) };
+    }
+    float extent = fmaxf(fmaxf(max.x - min.x, max.y - min.y), max.z - min.z);
+    float inv_extent = (extent > 0.0f) ? 1.0f / extent : 1.0f;
+    s->positions = arena_push(scratch, vertex_count * sizeof(vec3));
+    for (u32 i = 0; i < vertex_count; i++) {
+        s->positions[i] = v3_scale(v3_sub(*(vec3*)&p_mesh->vertex_data[i * 8], min), inv_extent);
+    }
+
+    // Vertices at the same position go into one group, hashed on the position's bits
+    s->groups = arena_push(scratch, vertex_count * sizeof(u32));
+    s->next_in_group = arena_push(scratch, vertex_count * sizeof(u32));
+    u32 table_size = 64;
+    while (table_size < vertex_count * 2) table_size *= 2;
+    u32* table = arena_push(scratch, table_size * sizeof(u32));
+    memset(table, 0xFF, table_size * sizeof(u32));
+    for (u32 i = 0; i < vertex_count; i++) {
+        u32* key = (u32*)&p_mesh->vertex_data[i * 8];
+        u32 slot = ((key[0] * 73856093u) ^ (key[1] * 19349663u) ^ (key[2] * 83492791u)) & (table_size - 1);
+        while (table[slot] != 0xFFFFFFFF && memcmp(&p_mesh->vertex_data[table[slot] * 8], key, 3 * sizeof(float)) != 0) {
+            slot = (slot + 1) & (table_size - 1);
+        }
+        if (table[slot] == 0xFFFFFFFF) table[slot] = i;
+        u32 group = table[slot];
+        s->groups[i] = group;
+        s->next_in_group[i] = (group == i) ? i : s->next_in_group[group];
+        if (group != i) s->next_in_group[group] = i;
+    }
+
+    // Planes of the triangles around each group, weighted by area
+    s->quadrics = arena_push(scratch, vertex_count * sizeof(meshquadric_t));
+    memset(s->quadrics, 0, vertex_count * sizeof(meshquadric_t));
+    for (u32 i = 0; i < s->index_count; i += 3) {
+        u32 g[3] = { s->groups[s->indices[i]], s->groups[s->indices[i + 1]], s->groups[s->indices[i + 2]] };
+        vec3 cross = v3_cross(v3_sub(s->positions[g[1]], s->positions[g[0]]), v3_sub(s->positions[g[2]], s->positions[g[0]]));
+        float length = sqrtf(v3_dot(cross, cross));
+        if (length == 0.0f) continue;
+        vec3 n = v3_scale(cross, 1.0f / length);
+        float d = -v3_dot(n, s->positions[g[0]]);
+        for (u32 j = 0; j < 3; j++) mesh_quadric_add_plane(&s->quadrics[g[j]], n, d, length * 0.5f);
+    }
+
+    // Open borders: edges with a single triangle get a plane along the edge, perpendicular
+    // to the triangle, so collapses don't pull the border in. Edges are counted in a hash table
+    u32 edge_table_size = 64;
+    while (edge_table_size < s->index_count * 2) edge_table_size *= 2;
+    u64* edge_keys = arena_push(scratch, edge_table_size * sizeof(u64));
+    u32* edge_counts = arena_push(scratch, edge_table_size * sizeof(u32));
+    memset(edge_keys, 0xFF, edge_table_size * sizeof(u64));
+    for (u32 pass = 0; pass < 2; pass++) {
+        for (u32 i = 0; i < s->index_count; i++) {
+            u32 a = s->groups[s->indices[i]];
+            u32 b = s->groups[s->indices[i - i % 3 + (i + 1) % 3]];
+            u64 key = (a < b) ? ((u64)a << 32 | b) : ((u64)b << 32 | a);
+            u32 slot = (u32)((key * 0x9E3779B97F4A7C15ull) >> 32) & (edge_table_size - 1);
+            while (edge_keys[slot] != key && edge_keys[slot] != ~(u64)0) slot = (slot + 1) & (edge_table_size - 1);
+            if (pass == 0) {
+                if (edge_keys[slot] != key) edge_counts[slot] = 0;
+                edge_keys[slot] = key;
+                edge_counts[slot]++;
+            } else if (edge_counts[slot] == 1 && a != b) {
+                u32 c = s->groups[s->indices[i - i % 3 + (i + 2) % 3]];
+                vec3 edge = v3_sub(s->positions[b], s->positions[a]);
+                vec3 normal = v3_cross(edge, v3_sub(s->positions[c], s->positions[a]));
+                vec3 border_normal = v3_cross(edge, normal);
+                float length = sqrtf(v3_dot(border_normal, border_normal));
+                if (length == 0.0f) continue;
+                border_normal = v3_scale(border_normal, 1.0f / length);
+                float d = -v3_dot(border_normal, s->positions[a]);
+                float weight = v3_dot(edge, edge) * MESH_LOD_BORDER_WEIGHT;
+                mesh_quadric_add_plane(&s->quadrics[a], border_normal, d, weight);
+                mesh_quadric_add_plane(&s->quadrics[b], border_normal, d, weight);
+            }
+        }
+    }
+    return extent;
+}
+
+float mesh_point_triangle_distance_sq(vec3 p, vec3 a, vec3 b, vec3 c) {
+    // Squared distance to the closest point of the triangle (Ericson, Real-Time Collision Detection 5.1.5)
+    vec3 ab = v3_sub(b, a), ac = v3_sub(c, a), ap = v3_sub(p, a);
+    float d1 = v3_dot(ab, ap), d2 = v3_dot(ac, ap);
+    vec3 closest;
+    if (d1 <= 0.0f && d2 <= 0.0f) {
+        closest = a;
+    } else {
+        vec3 bp = v3_sub(p, b), cp = v3_sub(p, c);
+        float d3 = v3_dot(ab, bp), d4 = v3_dot(ac, bp);
+        float d5 = v3_dot(ab, cp), d6 = v3_dot(ac, cp);
+        float vc = d1 * d4 - d3 * d2, vb = d5 * d2 - d1 * d6, va = d3 * d6 - d5 * d4;
+        if (d3 >= 0.0f && d4 <= d3) closest = b;
+        else if (d6 >= 0.0f && d5 <= d6) closest = c;
+        else if (vc <= 0.0f && d1 >= 0.0f && d3 <= 0.0f) closest = v3_add(a, v3_scale(ab, d1 / (d1 - d3)));
+        else if (vb <= 0.0f && d2 >= 0.0f && d6 <= 0.0f) closest = v3_add(a, v3_scale(ac, d2 / (d2 - d6)));
+        else if (va <= 0.0f && d4 - d3 >= 0.0f && d5 - d6 >= 0.0f) closest = v3_add(b, v3_scale(v3_sub(c, b), (d4 - d3) / ((d4 - d3) + (d5 - d6))));
+        else {
+            float sum = va + vb + vc;
+            if (sum <= 0.0f) closest = a; // Degenerate, the corners are all in a line
+            else closest = v3_add(a, v3_add(v3_scale(ab, vb / sum), v3_scale(ac, vc / sum)));
+        }
+    }
+    vec3 d = v3_sub(p, closest);
+    return v3_dot(d, d);
+}
+
+float mesh_ring_distance_sq(meshsimplify_t* s, vec3 p, u32 group) {
+    // To the closest of the triangles around "group"
+    float distance_sq = FLT_MAX;
+    u32 vertex = group;
+    do {
+        for (u32 i = s->triangle_offsets[vertex]; i < s->triangle_offsets[vertex + 1]; i++) {
+            u32* triangle = &s->indices[s->triangle_lists[i] * 3];
+            vec3 a = s->positions[s->groups[triangle[0]]];
+            vec3 b = s->positions[s->groups[triangle[1]]];
+            vec3 c = s->positions[s->groups[triangle[2]]];
+            distance_sq = fminf(distance_sq, mesh_point_triangle_distance_sq(p, a, b, c));
+        }
+        vertex = s->next_in_group[vertex];
+    } while (vertex != group);
+    return distance_sq;
+}
+
+float mesh_measure_error(meshsimplify_t* s, arena_t* scratch) {
+    // How far the original surface is from the current level, in normalized units: the largest
+    // distance from a removed vertex to the triangles within two rings of the vertex it ended
+    // up on. The closest triangle can be further away, so this can come out a bit high, and
+    // the surface between the original vertices isn't measured
+    u64 scratch_mark = arena_mark(scratch);
+    mesh_build_triangle_lists(s, scratch);
+    float max_distance_sq = 0.0f;
+    for (u32 group = 0; group < s->vertex_count; group++) {
+        if (s->groups[group] != group || s->collapsed_to[group] == group) continue;
+        u32 root = s->collapsed_to[group];
+        while (s->collapsed_to[root] != root) root = s->collapsed_to[root];
+
+        vec3 p = s->positions[group];
+        float distance_sq = mesh_ring_distance_sq(s, p, root);
+        if (distance_sq <= max_distance_sq) continue; // The second ring can only bring it down
+        u32 vertex = root;
+        do {
+            for (u32 i = s->triangle_offsets[vertex]; i < s->triangle_offsets[vertex + 1]; i++) {
+                u32* triangle = &s->indices[s->triangle_lists[i] * 3];
+                for (u32 j = 0; j < 3; j++) {
+                    u32 neighbor = s->groups[triangle[j]];
+                    if (neighbor != root) distance_sq = fminf(distance_sq, mesh_ring_distance_sq(s, p, neighbor));
+                }
+            }
+            vertex = s->next_in_group[vertex];
+        } while (vertex != root);
+        if (distance_sq != FLT_MAX) max_distance_sq = fmaxf(max_distance_sq, distance_sq);
+    }
+    arena_pop_to(scratch, scratch_mark);
+    return sqrtf(max_distance_sq);
+}
+
+void mesh_generate_lods(mesh_t* p_mesh, arena_t* mesh_arena, arena_t* scratch) {
+    // Each level aims for half the triangles of the one before. Stops early if the
+    // mesh can't be simplified much further, boxes with hard edges barely go down
+    p_mesh->lod_count = 1;
+    p_mesh->lods[0].first_index = 0;
+    p_mesh->lods[0].index_count = p_mesh->index_count;
+    p_mesh->lods[0].error = 0.0f;
+    if (p_mesh->index_count / 3 < MESH_LOD_MIN_TRIANGLES) return;
+
+    u64 scratch_mark = arena_mark(scratch);
+    meshsimplify_t s = { 0 };
+    float extent = mesh_init_simplify(&s, p_mesh, scratch);
+
+    u32* level_indices[MESH_MAX_LODS] = { 0 };
+    u32 total_index_count = p_mesh->index_count;
+    float max_error = 0.0f; // Levels are made from each other, so it can only grow
+    u32 previous_count = p_mesh->index_count;
+    while (p_mesh->lod_count < MESH_MAX_LODS) {
+        u32 target = previous_count / 6 * 3;
+        bool stuck = false;
+        while (s.index_count > target && !stuck) {
+            stuck = (mesh_simplify_pass(&s, target, scratch) == 0);
+        }
+        if (s.index_count > previous_count * 3 / 4) break; // Not worth a level
+
+        meshlod_t* p_lod = &p_mesh->lods[p_mesh->lod_count];
+        p_lod->first_index = total_index_count;
+        p_lod->index_count = s.index_count;
+        max_error = fmaxf(max_error, mesh_measure_error(&s, scratch));
+        p_lod->error = max_error * extent; // Model units, main.c turns it into pixels
+        level_indices[p_mesh->lod_count] = arena_push(scratch, s.index_count * sizeof(u32));
+        memcpy(level_indices[p_mesh->lod_count], s.indices, s.index_count * sizeof(u32));
+        total_index_count += s.index_count;
+        previous_count = s.index_count;
+        p_mesh->lod_count++;
+        if (stuck) break;
+    }
+
+    if (p_mesh->lod_count > 1) {
+        // Levels go after the full mesh, each one reordered for the vertex cache
+        void* index_data = arena_push(mesh_arena, total_index_count * p_mesh->index_size);
+        memcpy(index_data, p_mesh->index_data, p_mesh->index_count * p_mesh->index_size);
+        p_mesh->index_data = index_data;
+        for (u32 i_lod = 1; i_lod < p_mesh->lod_count; i_lod++) {
+            meshlod_t* p_lod = &p_mesh->lods[i_lod];
+            mesh_t level = *p_mesh;
+            level.index_data = (u8*)index_data + p_lod->first_index * p_mesh->index_size;
+            level.index_count = p_lod->index_count;
+            for (u32 i = 0; i < p_lod->index_count; i++) mesh_set_index(&level, i, level_indices[i_lod][i]);
+
+            u32* reordered = arena_push(scratch, p_lod->index_count * sizeof(u32));
+            u32* cluster_starts = arena_push(scratch, p_lod->index_count / 3 * sizeof(u32));
+            mesh_tipsify(&level, reordered, cluster_starts, scratch);
+            for (u32 i = 0; i < p_lod->index_count; i++) mesh_set_index(&level, i, reordered[i]);
+        }
+        p_mesh->index_count = total_index_count;
+    }
+    arena_pop_to(scratch, scratch_mark);
+}
+
+void mesh_compute_meshlet_bounds(mesh_t* p_mesh, meshlet_t* p_meshlet) {
+    // Sphere around the box of the triangles, and the cone their normals fall in. Normals are
+    // taken from the triangles themselves, the vertex ones are smoothed across hard edges
+    vec3 min = { FLT_MAX, FLT_MAX, FLT_MAX };
+    vec3 max = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+    vec3 normal_sum = { 0 };
+    u32 end = p_meshlet->first_index + p_meshlet->triangle_count * 3;
+    for (u32 i = p_meshlet->first_index; i < end; i += 3) {
+        vec3 a = *(vec3*)&p_mesh->vertex_data[mesh_get_index(p_mesh, i + 0) * 8];
+        vec3 b = *(vec3*)&p_mesh->vertex_data[mesh_get_index(p_mesh, i + 1) * 8];
+        vec3 c = *(vec3*)&p_mesh->vertex_data[mesh_get_index(p_mesh, i + 2) * 8];
+        min = (vec3){ fminf(min.x, fminf(a.x, fminf(b.x, c.x))), fminf(min.y, fminf(a.y, fminf(b.y, c.y))), fminf(min.z, fminf(a.z, fminf(b.z, c.z))) };
+        max = (vec3){ fmaxf(max.x, fmaxf(a.x, fmaxf(b.x, c.x))), fmaxf(max.y, fmaxf(a.y, fmaxf(b.y, c.y))), fmaxf(max.z, fmaxf(a.z, fmaxf(b.z, c.z))) };
+        normal_sum = v3_add(normal_sum, v3_cross(v3_sub(b, a), v3_sub(c, a))); // Weighted by area
+    }
+
+    vec3 center = v3_scale(v3_add(min, max), 0.5f);
+    float radius_squared = 0.0f;
+    for (u32 i = p_meshlet->first_index; i < end; i++) {
+        vec3 d = v3_sub(*(vec3*)&p_mesh->vertex_data[mesh_get_index(p_mesh, i) * 8], center);
+        radius_squared = fmaxf(radius_squared, v3_dot(d, d));
+    }
+    p_meshlet->center[0] = center.x;
+    p_meshlet->center[1] = center.y;
+    p_meshlet->center[2] = center.z;
+    p_meshlet->radius = sqrtf(radius_squared);
+
+    p_meshlet->cone_axis[0] = p_meshlet->cone_axis[1] = p_meshlet->cone_axis[2] = 0.0f;
+    p_meshlet->cone_cutoff = 1.0f;
+    if (v3_iszero(normal_sum)) return;
+    vec3 axis = v3_norm(normal_sum);
+    float min_dot = 1.0f;
+    for (u32 i = p_meshlet->first_index; i < end; i += 3) {
+        vec3 a = *(vec3*)&p_mesh->vertex_data[mesh_get_index(p_mesh, i + 0) * 8];
+        vec3 b = *(vec3*)&p_mesh->vertex_data[mesh_get_index(p_mesh, i + 1) * 8];
+        vec3 c = *(vec3*)&p_mesh->vertex_data[mesh_get_index(p_mesh, i + 2) * 8];
+        vec3 normal = v3_cross(v3_sub(b, a), v3_sub(c, a));
+        if (v3_iszero(normal)) continue;
+        min_dot = fminf(min_dot, v3_dot(v3_norm(normal), axis));
+    }
+    if (min_dot <= 0.0f) return; // Wider than a half space, some triangle always faces the camera
+
+    p_meshlet->cone_axis[0] = axis.x;
+    p_meshlet->cone_axis[1] = axis.y;
+    p_meshlet->cone_axis[2] = axis.z;
+    p_meshlet->cone_cutoff = sqrtf(1.0f - min_dot * min_dot);
+}
+
+void mesh_build_meshlets(mesh_t* p_mesh, arena_t* mesh_arena, arena_t* scratch) {
+    // Cuts the full mesh's triangles into runs, in the order they're in. The vertex cache
+    // optimizer already keeps neighbours together, so the runs come out compact and the
+    // index buffer doesn't change. A run ends when the next triangle would go over a limit
+    p_mesh->meshlets = NULL;
+    p_mesh->meshlet_count = 0;
+    u32 triangle_count = p_mesh->lods[0].index_count / 3;
+    if (triangle_count < MESH_MESHLET_MIN_TRIANGLES) return;
+
+    u64 scratch_mark = arena_mark(scratch);
+    u32* last_meshlet = arena_push(scratch, p_mesh->vertex_count * sizeof(u32)); // Which meshlet saw a vertex last
+    memset(last_meshlet, 0xFF, p_mesh->vertex_count * sizeof(u32));
+    u32 max_meshlet_count = triangle_count / (MESHLET_MAX_VERTICES / 3) + 1; // Every meshlet but the last holds at least this many
+    meshlet_t* meshlets = arena_push(scratch, max_meshlet_count * sizeof(meshlet_t));
+    u32 meshlet_count = 0;
+
+    meshlet_t* p_current = &meshlets[0];
+    memset(p_current, 0, sizeof(meshlet_t));
+    for (u32 i_triangle = 0; i_triangle < triangle_count; i_triangle++) {
+        u32 corners[3];
+        for (u32 i = 0; i < 3; i++) corners[i] = mesh_get_index(p_mesh, p_mesh->lods[0].first_index + i_triangle * 3 + i);
+
+        u32 new_vertex_count = 0;
+        for (u32 i = 0; i < 3; i++) {
+            bool repeated = (i > 0 && corners[i] == corners[0]) || (i > 1 && corners[i] == corners[1]);
+            if (last_meshlet[corners[i]] != meshlet_count && !repeated) new_vertex_count++;
+        }
+        if (p_current->triangle_count == MESHLET_MAX_TRIANGLES || p_current->vertex_count + new_vertex_count > MESHLET_MAX_VERTICES) {
+            mesh_compute_meshlet_bounds(p_mesh, p_current);
+            meshlet_count++;
+            p_current = &meshlets[meshlet_count];
+            memset(p_current, 0, sizeof(meshlet_t));
+            p_current->first_index = p_mesh->lods[0].first_index + i_triangle * 3;
+            new_vertex_count = 1 + (corners[1] != corners[0]) + (corners[2] != corners[0] && corners[2] != corners[1]);
+        }
+
+        for (u32 i = 0; i < 3; i++) last_meshlet[corners[i]] = meshlet_count;
+        p_current->vertex_count += new_vertex_count;
+        p_current->triangle_count++;
+    }
+    mesh_compute_meshlet_bounds(p_mesh, p_current);
+    meshlet_count++;
+    assert(meshlet_count <= max_meshlet_count);
+
+    p_mesh->meshlets = arena_push(mesh_arena, meshlet_count * sizeof(meshlet_t));
+    memcpy(p_mesh->meshlets, meshlets, meshlet_count * sizeof(meshlet_t));
+    p_mesh->meshlet_count = meshlet_count;
+    arena_pop_to(scratch, scratch_mark);
+}
@@ -0,0 +1,260 @@
+// Pack builder, run with --build-pack. Everything the game loads goes into a
+// single file: models with their mesh caches, textures (and their baked
+// versions, if --bake-textures was run), shaders and the font. Entries are
+// compressed in blocks unless that doesn't save enough (PNGs, mostly), add
+// --uncompressed to store everything as is. See vfs.c for the runtime side,
+// --bench-pack compares load times of the two
+
+u32 pack_collect_files(char* directory, char* extension, char (*paths)[PACK_PATH_LEN], u32 path_count) {
+    // Appends "directory/*.extension" to paths, returns the new count
+    char pattern[MAX_PATH];
+    snprintf(pattern, MAX_PATH, "%s/*.%s", directory, extension);
+    WIN32_FIND_DATAA find_data;
+    HANDLE find_handle = FindFirstFileA(pattern, &find_data);
+    if (find_handle == INVALID_HANDLE_VALUE) return path_count;
+
+    do {
+        assert(path_count < PACK_MAX_FILES);
+        char path[MAX_PATH];
+        snprintf(path, MAX_PATH, "%s/%s", directory, find_data.cFileName);
+        if (strlen(path) >= PACK_PATH_LEN) {
+            printf("path too long for the pack, skipped: %s\n", path);
+            continue;
+        }
+        vfs_normalize_path(path, paths[path_count], PACK_PATH_LEN);
+        path_count++;
+    } while (FindNextFileA(find_handle, &find_data));
+    FindClose(find_handle);
+    return path_count;
+}
+
+void pack_check_mesh_caches(char (*paths)[PACK_PATH_LEN], u32 path_count) {
+    // Mesh caches are written by the game the first time it loads a model, the builder doesn't parse anything
+    for (u32 i = 0; i < path_count; i++) {
+        char* extension = strrchr(paths[i], '.');
+        if (extension == NULL || strcmp(extension, ".obj") != 0) continue;
+
+        char cache_filename[MAX_PATH];
+        u64 cache_size, cache_mtime;
+        get_mesh_cache_filename(paths[i], cache_filename, MAX_PATH);
+        if (!get_file_info(cache_filename, &cache_size, &cache_mtime)) {
+            printf("  no mesh cache for %s, it'll be parsed at startup\n", paths[i]);
+        }
+    }
+}
+
+u64 pack_compress_entry(u8* data, u64 size, u8* result, u32* p_block_count) {
+    // Writes the block size table and the blocks, returns the size of both.
+    // A block that doesn't get smaller is stored as is
+    u32 block_count = (u32)((size + PACK_BLOCK_SIZE - 1) / PACK_BLOCK_SIZE);
+    u32* block_sizes = (u32*)result;
+    u8* block = (u8*)(block_sizes + block_count);
+    for (u32 i = 0; i < block_count; i++) {
+        u64 block_offset = (u64)i * PACK_BLOCK_SIZE;
+        u64 block_size = size - block_offset;
+        if (block_size > PACK_BLOCK_SIZE) block_size = PACK_BLOCK_SIZE;
+
+        u64 stored_size = lz_compress(data + block_offset, block_size, block, block_size - 1);
+        if (stored_size == 0) {
+            memcpy(block, data + block_offset, block_size);
+            stored_size = block_size;
+            block_sizes[i] = (u32)block_size | PACK_BLOCK_STORED;
+        } else {
+            block_sizes[i] = (u32)stored_size;
+        }
+        block += stored_size;
+    }
+    *p_block_count = block_count;
+    return (u64)(block - result);
+}
+
+bool build_pack(char* pack_filename, bool compress) {
+    // False if the pack couldn't be written
+    static char paths[PACK_MAX_FILES][PACK_PATH_LEN];
+    u32 path_count = 0;
+    path_count = pack_collect_files("models", "obj", paths, path_count);
+    path_count = pack_collect_files("models", "mtl", paths, path_count);
+    path_count = pack_collect_files("models", "p7mesh", paths, path_count);
+    path_count = pack_collect_files("textures", "png", paths, path_count);
+    path_count = pack_collect_files("textures", "p7tex", paths, path_count);
+    path_count = pack_collect_files("src", "glsl", paths, path_count);
+    path_count = pack_collect_files(".", "ttf", paths, path_count);
+    pack_check_mesh_caches(paths, path_count);
+
+    FILE* f = fopen(pack_filename, "wb");
+    if (f == NULL) {
+        printf("can't write pack: %s\n", pack_filename);
+        return false;
+    }
+
+    // Header goes in last, once the offsets are known
+    #define PACK_ALIGN_UP(x) (((x) + PACK_ALIGN - 1) & ~(u64)(PACK_ALIGN - 1))
+    static const u8 padding[PACK_ALIGN] = { 0 };
+    arena_t* scratch = get_scratch_arena(0);
+    u64 scratch_mark = arena_mark(scratch);
+    packentry_t* entries = arena_push(scratch, path_count * sizeof(packentry_t));
+    memset(entries, 0, path_count * sizeof(packentry_t));
+    packheader_t header = { 0 };
+    fwrite(&header, sizeof(header), 1, f);
+    u64 written = sizeof(header);
+
+    u32 entry_count = 0;
+    u64 total_size = 0;
+    for (u32 i = 0; i < path_count; i++) {
+        packentry_t* p_entry = &entries[entry_count];
+        filemap_t file = map_entire_file(paths[i], true);
+        if (file.file == NULL || !get_file_info(paths[i], &p_entry->size, &p_entry->mtime)) {
+            printf("can't read, skipped: %s\n", paths[i]);
+            unmap_file(&file);
+            continue;
+        }
+
+        u64 entry_mark = arena_mark(scratch);
+        u8* stored_data = file.data;
+        p_entry->stored_size = file.size;
+        if (compress && file.size >= PACK_BLOCK_SIZE / 16) { // Tiny files aren't worth it
+            u32 max_block_count = (u32)((file.size + PACK_BLOCK_SIZE - 1) / PACK_BLOCK_SIZE);
+            u8* compressed = arena_push(scratch, max_block_count * sizeof(u32) + file.size);
+            u32 block_count;
+            u64 compressed_size = pack_compress_entry(file.data, file.size, compressed, &block_count);
+            if (compressed_size * PACK_MIN_SAVING <= file.size * (PACK_MIN_SAVING - 1)) {
+                stored_data = compressed;
+                p_entry->stored_size = compressed_size;
+                p_entry->block_count = block_count;
+            }
+        }
+
+        u64 offset = PACK_ALIGN_UP(written);
+        fwrite(padding, 1, offset - written, f);
+        fwrite(stored_data, 1, p_entry->stored_size, f);
+        written = offset + p_entry->stored_size;
+        unmap_file(&file);
+        arena_pop_to(scratch, entry_mark);
+
+        strcpy_s(p_entry->path, PACK_PATH_LEN, paths[i]);
+        p_entry->path_hash = vfs_hash_path(p_entry->path);
+        p_entry->offset = offset;
+        total_size += p_entry->size;
+        entry_count++;
+    }
+
+    // At most half full, so probe chains stay short
+    u32 bucket_count = 16;
+    while (bucket_count < entry_count * 2) bucket_count *= 2;
+    u32* buckets = arena_push(scratch, bucket_count * sizeof(u32));
+    memset(buckets, 0, bucket_count * sizeof(u32));
+    for (u32 i = 0; i < entry_count; i++) {
+        u32 i_bucket = (u32)entries[i].path_hash & (bucket_count - 1);
+        while (buckets[i_bucket] != 0) i_bucket = (i_bucket + 1) & (bucket_count - 1);
+        buckets[i_bucket] = i + 1;
+    }
+
+    header.magic = PACK_MAGIC;
+    header.version = PACK_VERSION;
+    header.entry_count = entry_count;
+    header.bucket_count = bucket_count;
+    header.toc_offset = PACK_ALIGN_UP(written);
+    header.bucket_offset = header.toc_offset + entry_count * sizeof(packentry_t);
+    fwrite(padding, 1, header.toc_offset - written, f);
+    fwrite(entries, sizeof(packentry_t), entry_count, f);
+    fwrite(buckets, sizeof(u32), bucket_count, f);
+    written = header.bucket_offset + bucket_count * sizeof(u32);
+    fseek(f, 0, SEEK_SET);
+    fwrite(&header, sizeof(header), 1, f);
+    #undef PACK_ALIGN_UP
+
+    bool write_failed = ferror(f) != 0;
+    write_failed |= fclose(f) != 0;
+    arena_pop_to(scratch, scratch_mark);
+    if (write_failed) {
+        printf("couldn't write all of the pack: %s\n", pack_filename);
+        DeleteFileA(pack_filename);
+        return false;
+    }
+    printf("packed %u files into %s, %.2f MB (%.2f MB uncompressed)\n", entry_count, pack_filename,
+            (double)written / (1024.0 * 1024.0), (double)total_size / (1024.0 * 1024.0));
+    return true;
+}
+
+filemap_t pack_read_unbuffered(char* file_name) {
+    // Reads around the file cache, so the data comes off the disk like on a cold start.
+    // Unbuffered reads have to be sector aligned: the buffer is page aligned and the size rounded up
+    filemap_t map = { 0 };
+    HANDLE file = CreateFileA(file_name, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_NO_BUFFERING, NULL);
+    if (file == INVALID_HANDLE_VALUE) return map;
+
+    LARGE_INTEGER file_size;
+    GetFileSizeEx(file, &file_size);
+    map.size = (u64)file_size.QuadPart;
+    u64 read_size = (map.size + 4095) & ~(u64)4095;
+    map.data = VirtualAlloc(NULL, read_size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+    assert(map.data);
+    map.owns_data = true;
+    for (u64 offset = 0; offset < read_size;) {
+        DWORD bytes_read = 0;
+        DWORD chunk_size = (read_size - offset > (8 << 20)) ? (8 << 20) : (DWORD)(read_size - offset);
+        if (!ReadFile(file, map.data + offset, chunk_size, &bytes_read, NULL) || bytes_read == 0) break;
+        offset += bytes_read;
+    }
+    CloseHandle(file);
+    return map;
+}
+
+u64 pack_load_all(void) {
+    // Maps every entry of the mounted pack and reads all of it, what a load does minus the parsing.
+    // Returns a checksum so the two packs can be compared
+    u64 checksum = 0;
+    for (u32 i = 0; i < vfs.p_header->entry_count; i++) {
+        filemap_t file = map_entire_file(vfs.entries[i].path, true);
+        for (u64 j = 0; j < file.size; j++) {
+            checksum = checksum * 31 + file.data[j];
+        }
+        unmap_file(&file);
+    }
+    return checksum;
+}
+
+void bench_pack(void) {
+    // Builds the pack both ways and times mounting it and reading every entry.
+    // Cold reads the pack around the file cache, warm is the best of a few runs with the pack cached
+    char* pack_filenames[2] = { "bench_uncompressed.p7pack", "bench_compressed.p7pack" };
+    if (!build_pack(pack_filenames[0], false) || !build_pack(pack_filenames[1], true)) {
+        printf("pack bench skipped, a pack couldn't be built\n");
+        DeleteFileA(pack_filenames[0]);
+        return;
+    }
+
+    // Large compressed entries are decompressed on up to one thread per CPU, so
+    // the compressed times only show the threaded decompression with several
+    SYSTEM_INFO system_info;
+    GetSystemInfo(&system_info);
+    printf("pack load times, mount + read every entry, %u CPU%s:\n", (u32)system_info.dwNumberOfProcessors,
+            (system_info.dwNumberOfProcessors > 1) ? "s" : " (decompression runs on one thread)");
+    u64 checksums[2];
+    for (u32 i = 0; i < 2; i++) {
+        double start_time = glfwGetTime();
+        if (!vfs_mount_view(pack_read_unbuffered(pack_filenames[i]), pack_filenames[i])) return;
+        checksums[i] = pack_load_all();
+        double cold_time = glfwGetTime() - start_time;
+        u64 pack_size = vfs.pack_file.size;
+        vfs_unmount();
+
+        double warm_time = 1e9;
+        for (u32 run = 0; run < 4; run++) {
+            start_time = glfwGetTime();
+            vfs_mount(pack_filenames[i]);
+            pack_load_all();
+            double run_time = glfwGetTime() - start_time;
+            vfs_unmount();
+            if (run > 0 && run_time < warm_time) warm_time = run_time; // The first run pages the mapping in
+        }
+        printf("  %-12s %7.2f MB, cold %8.2f ms, warm %8.2f ms\n", (i == 0) ? "uncompressed" : "compressed",
+                (double)pack_size / (1024.0 * 1024.0), cold_time * 1000.0, warm_time * 1000.0);
+    }
+    if (checksums[0] != checksums[1]) {
+        printf("compressed pack doesn't match the uncompressed one\n");
+        assert(false);
+    }
+    DeleteFileA(pack_filenames[0]);
+    DeleteFileA(pack_filenames[1]);
+}
@@ -2,12 +2,13 @@
 
 in vec2 v2f_uv;
 in vec3 v2f_normal;
+flat in int v2f_layer;
 
 out vec4 o_color;
 
-uniform sampler2D u_tex;
+uniform sampler2DArray u_tex;
 
 void main()
 {
-    o_color = texture(u_tex, v2f_uv) + vec4(v2f_normal * 0.001, 0.1);
+    o_color = texture(u_tex, vec3(v2f_uv, v2f_layer)) + vec4(v2f_normal * 0.001, 0.1);
 }
@@ -2,18 +2,60 @@
 
 layout (location = 0) in vec3 in_pos;
 layout (location = 1) in vec2 in_uv;
-layout (location = 2) in vec3 in_normal;
+layout (location = 2) in vec3 in_normal; // Octahedral in xy with compact vertices
+layout (location = 3) in mat4 in_model; // Per instance, see render_create_instances, or per pooled draw
+layout (location = 7) in int in_layer;
+layout (location = 8) in vec4 in_dequant[3]; // Pooled draws only, see render_pool_draw
 
-uniform mat4 u_model;
-uniform mat4 u_view;
-uniform mat4 u_proj;
+layout (std140) uniform camera_block // Shared by every program, updated once per frame
+{
+    mat4 u_view;
+    mat4 u_proj;
+    mat4 u_view_proj;
+    vec4 u_eye;
+};
+
+layout (std140) uniform object_block // One per draw, from the uniform ring
+{
+    mat4 u_model;
+    vec4 u_dequant[3]; // Position offset, position scale (w is 1 for octahedral normals), uv offset and scale
+    ivec4 u_layer; // x is the texture array layer, y is the draw mode
+};
+
+// RENDER_DRAW_* in main.c
+const int DRAW_SINGLE = 0;
+const int DRAW_INSTANCED = 1;
+const int DRAW_POOLED = 2;
 
 out vec2 v2f_uv;
 out vec3 v2f_normal;
+flat out int v2f_layer;
+
+vec3 oct_decode(vec2 e)
+{
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    float t = max(-n.z, 0.0);
+    n.xy += vec2(n.x >= 0.0 ? -t : t, n.y >= 0.0 ? -t : t);
+    return normalize(n);
+}
 
 void main()
 {
-    v2f_uv = in_uv;
-    v2f_normal = in_normal;
-    gl_Position = u_proj * u_view * u_model * vec4(in_pos, 1.0);
+    // Pooled draws have an identity u_model, so they go through the instanced path too
+    mat4 model = u_model;
+    int layer = u_layer.x;
+    vec4 dequant[3] = u_dequant;
+    if (u_layer.y != DRAW_SINGLE) {
+        model = u_model * in_model;
+        layer = in_layer;
+    }
+    if (u_layer.y == DRAW_POOLED) {
+        dequant = in_dequant;
+    }
+
+    vec3 pos = dequant[0].xyz + in_pos * dequant[1].xyz;
+    v2f_uv = dequant[2].xy + in_uv * dequant[2].zw;
+    v2f_normal = (dequant[1].w > 0.0) ? oct_decode(in_normal.xy) : in_normal;
+    v2f_layer = layer;
+    gl_Position = u_view_proj * model * vec4(pos, 1.0);
 }
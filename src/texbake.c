@@ -0,0 +1,370 @@
+// Offline texture baking, run with --bake-textures. Every PNG becomes a .p7tex
+// next to it: BC1 if it's opaque, BC3 if it has alpha, with the whole mip chain.
+// The encoder fits the block's bounding box in RGB and picks indices with SSE2
+
+u16 bake_pack_565(u8* color) {
+    u32 r = (color[0] * 31 + 127) / 255;
+    u32 g = (color[1] * 63 + 127) / 255;
+    u32 b = (color[2] * 31 + 127) / 255;
+    return (u16)((r << 11) | (g << 5) | b);
+}
+
+void bake_unpack_565(u16 packed, u8* color) {
+    u32 r = (packed >> 11) & 31;
+    u32 g = (packed >> 5) & 63;
+    u32 b = packed & 31;
+    color[0] = (u8)((r << 3) | (r >> 2));
+    color[1] = (u8)((g << 2) | (g >> 4));
+    color[2] = (u8)((b << 3) | (b >> 2));
+    color[3] = 0; // Left out of the color distances
+}
+
+void bake_get_block(u8* image, u32 width, u32 height, u32 x, u32 y, u8* block) {
+    // 4x4 RGBA texels, edge texels are repeated for images smaller than a block
+    for (u32 row = 0; row < 4; row++) {
+        u32 src_y = (y + row < height) ? y + row : height - 1;
+        for (u32 col = 0; col < 4; col++) {
+            u32 src_x = (x + col < width) ? x + col : width - 1;
+            memcpy(block + (row * 4 + col) * 4, image + ((u64)src_y * width + src_x) * 4, 4);
+        }
+    }
+}
+
+void bake_encode_color_block(u8* block, u8* out) {
+    __m128i rows[4];
+    for (u32 i = 0; i < 4; i++) {
+        rows[i] = _mm_loadu_si128((__m128i*)(block + i * 16));
+    }
+
+    // Bounding box, reduced down to a single texel
+    __m128i min_color = _mm_min_epu8(_mm_min_epu8(rows[0], rows[1]), _mm_min_epu8(rows[2], rows[3]));
+    __m128i max_color = _mm_max_epu8(_mm_max_epu8(rows[0], rows[1]), _mm_max_epu8(rows[2], rows[3]));
+    min_color = _mm_min_epu8(min_color, _mm_shuffle_epi32(min_color, _MM_SHUFFLE(2, 3, 0, 1)));
+    min_color = _mm_min_epu8(min_color, _mm_shuffle_epi32(min_color, _MM_SHUFFLE(1, 0, 3, 2)));
+    max_color = _mm_max_epu8(max_color, _mm_shuffle_epi32(max_color, _MM_SHUFFLE(2, 3, 0, 1)));
+    max_color = _mm_max_epu8(max_color, _mm_shuffle_epi32(max_color, _MM_SHUFFLE(1, 0, 3, 2)));
+    u32 min_texel = (u32)_mm_cvtsi128_si32(min_color);
+    u32 max_texel = (u32)_mm_cvtsi128_si32(max_color);
+    u8* lo = (u8*)&min_texel;
+    u8* hi = (u8*)&max_texel;
+
+    // Pull the endpoints in by 1/16th of the box, the extremes are rarely the best fit
+    for (u32 i = 0; i < 3; i++) {
+        u8 inset = (u8)((hi[i] - lo[i]) >> 4);
+        lo[i] += inset;
+        hi[i] -= inset;
+    }
+
+    // c0 > c1 selects the 4-color mode
+    u16 c0 = bake_pack_565(hi);
+    u16 c1 = bake_pack_565(lo);
+    if (c0 < c1) {
+        u16 temp = c0;
+        c0 = c1;
+        c1 = temp;
+    }
+    out[0] = (u8)c0;
+    out[1] = (u8)(c0 >> 8);
+    out[2] = (u8)c1;
+    out[3] = (u8)(c1 >> 8);
+    memset(out + 4, 0, 4);
+    if (c0 == c1) return; // Flat block, every index is 0
+
+    u8 palette[4][4];
+    bake_unpack_565(c0, palette[0]);
+    bake_unpack_565(c1, palette[1]);
+    for (u32 i = 0; i < 3; i++) {
+        palette[2][i] = (u8)((2 * palette[0][i] + palette[1][i]) / 3);
+        palette[3][i] = (u8)((palette[0][i] + 2 * palette[1][i]) / 3);
+    }
+    palette[2][3] = palette[3][3] = 0;
+
+    // Palette colors widened to 16 bits, two texels' worth per register
+    __m128i palette_wide[4];
+    for (u32 i = 0; i < 4; i++) {
+        palette_wide[i] = _mm_set_epi16(0, palette[i][2], palette[i][1], palette[i][0], 0, palette[i][2], palette[i][1], palette[i][0]);
+    }
+
+    __m128i zero = _mm_setzero_si128();
+    __m128i rgb_mask = _mm_set1_epi32(0x00FFFFFF);
+    u32 indices = 0;
+    for (u32 row = 0; row < 4; row++) {
+        __m128i texels = _mm_and_si128(rows[row], rgb_mask);
+        __m128i texels_lo = _mm_unpacklo_epi8(texels, zero); // Texels 0 and 1
+        __m128i texels_hi = _mm_unpackhi_epi8(texels, zero); // 2 and 3
+
+        __m128i best_error = _mm_set1_epi32(0x7FFFFFFF);
+        __m128i best_index = zero;
+        for (u32 i = 0; i < 4; i++) {
+            // Squared distance per texel: madd gives r*r+g*g and b*b+a*a, then the two halves are added up
+            __m128i diff_lo = _mm_sub_epi16(texels_lo, palette_wide[i]);
+            __m128i diff_hi = _mm_sub_epi16(texels_hi, palette_wide[i]);
+            __m128 square_lo = _mm_castsi128_ps(_mm_madd_epi16(diff_lo, diff_lo));
+            __m128 square_hi = _mm_castsi128_ps(_mm_madd_epi16(diff_hi, diff_hi));
+            __m128i error = _mm_add_epi32(
+                    _mm_castps_si128(_mm_shuffle_ps(square_lo, square_hi, _MM_SHUFFLE(2, 0, 2, 0))),
+                    _mm_castps_si128(_mm_shuffle_ps(square_lo, square_hi, _MM_SHUFFLE(3, 1, 3, 1))));
+
+            __m128i closer = _mm_cmplt_epi32(error, best_error);
+            best_error = _mm_or_si128(_mm_and_si128(closer, error), _mm_andnot_si128(closer, best_error));
+            best_index = _mm_or_si128(_mm_and_si128(closer, _mm_set1_epi32((int)i)), _mm_andnot_si128(closer, best_index));
+        }
+
+        u32 row_indices[4];
+        _mm_storeu_si128((__m128i*)row_indices, best_index);
+        for (u32 col = 0; col < 4; col++) {
+            indices |= row_indices[col] << (2 * (row * 4 + col));
+        }
+    }
+    memcpy(out + 4, &indices, 4);
+}
+
+void bake_encode_alpha_block(u8* block, u8* out) {
+    // a0 > a1 selects the 8-value mode, which is all we produce
+    u8 a0 = 0, a1 = 255;
+    for (u32 i = 0; i < 16; i++) {
+        u8 alpha = block[i * 4 + 3];
+        if (alpha > a0) a0 = alpha;
+        if (alpha < a1) a1 = alpha;
+    }
+    out[0] = a0;
+    out[1] = a1;
+
+    u64 indices = 0;
+    if (a0 != a1) {
+        u32 palette[8] = { a0, a1 };
+        for (u32 i = 1; i < 7; i++) {
+            palette[i + 1] = ((7 - i) * a0 + i * a1 + 3) / 7;
+        }
+        for (u32 i = 0; i < 16; i++) {
+            u32 alpha = block[i * 4 + 3];
+            u32 best_index = 0, best_error = 256;
+            for (u32 j = 0; j < 8; j++) {
+                u32 error = (alpha > palette[j]) ? alpha - palette[j] : palette[j] - alpha;
+                if (error < best_error) {
+                    best_error = error;
+                    best_index = j;
+                }
+            }
+            indices |= (u64)best_index << (3 * i);
+        }
+    }
+    for (u32 i = 0; i < 6; i++) {
+        out[2 + i] = (u8)(indices >> (8 * i));
+    }
+}
+
+void bake_decode_block(u8* in, bool has_alpha, u8* block) {
+    // Only for the quality report
+    u8* color_in = has_alpha ? in + 8 : in;
+    u16 c0 = (u16)(color_in[0] | (color_in[1] << 8));
+    u16 c1 = (u16)(color_in[2] | (color_in[3] << 8));
+    u8 palette[4][4];
+    bake_unpack_565(c0, palette[0]);
+    bake_unpack_565(c1, palette[1]);
+    for (u32 i = 0; i < 3; i++) {
+        if (c0 > c1 || has_alpha) {
+            palette[2][i] = (u8)((2 * palette[0][i] + palette[1][i]) / 3);
+            palette[3][i] = (u8)((palette[0][i] + 2 * palette[1][i]) / 3);
+        }
+        else {
+            palette[2][i] = (u8)((palette[0][i] + palette[1][i]) / 2);
+            palette[3][i] = 0;
+        }
+    }
+    u32 indices;
+    memcpy(&indices, color_in + 4, 4);
+    for (u32 i = 0; i < 16; i++) {
+        memcpy(block + i * 4, palette[(indices >> (2 * i)) & 3], 3);
+        block[i * 4 + 3] = 255;
+    }
+
+    if (!has_alpha) return;
+    u32 a0 = in[0], a1 = in[1];
+    u32 alpha_palette[8] = { a0, a1 };
+    for (u32 i = 1; i < 7; i++) {
+        alpha_palette[i + 1] = ((7 - i) * a0 + i * a1 + 3) / 7;
+    }
+    u64 alpha_indices = 0;
+    for (u32 i = 0; i < 6; i++) {
+        alpha_indices |= (u64)in[2 + i] << (8 * i);
+    }
+    for (u32 i = 0; i < 16; i++) {
+        block[i * 4 + 3] = (u8)alpha_palette[(alpha_indices >> (3 * i)) & 7];
+    }
+}
+
+u32 bake_block_size(bool has_alpha) {
+    return has_alpha ? 16 : 8;
+}
+
+u64 bake_compressed_size(u32 width, u32 height, bool has_alpha) {
+    return (u64)((width + 3) / 4) * ((height + 3) / 4) * bake_block_size(has_alpha);
+}
+
+void bake_compress(u8* image, u32 width, u32 height, bool has_alpha, u8* out) {
+    u8 block[64];
+    for (u32 y = 0; y < height; y += 4) {
+        for (u32 x = 0; x < width; x += 4) {
+            bake_get_block(image, width, height, x, y, block);
+            if (has_alpha) {
+                bake_encode_alpha_block(block, out);
+                out += 8;
+            }
+            bake_encode_color_block(block, out);
+            out += 8;
+        }
+    }
+}
+
+double bake_psnr(u8* image, u32 width, u32 height, bool has_alpha, u8* blocks) {
+    // Decodes the blocks back and compares them against the source, over RGB (and A for BC3)
+    u8 source_block[64], decoded_block[64];
+    u32 channel_count = has_alpha ? 4 : 3;
+    double squared_error = 0;
+    for (u32 y = 0; y < height; y += 4) {
+        for (u32 x = 0; x < width; x += 4) {
+            bake_get_block(image, width, height, x, y, source_block);
+            bake_decode_block(blocks, has_alpha, decoded_block);
+            blocks += bake_block_size(has_alpha);
+
+            // Texels outside the image are repeats, they don't count
+            for (u32 row = 0; row < 4 && y + row < height; row++) {
+                for (u32 col = 0; col < 4 && x + col < width; col++) {
+                    for (u32 c = 0; c < channel_count; c++) {
+                        i32 diff = source_block[(row * 4 + col) * 4 + c] - decoded_block[(row * 4 + col) * 4 + c];
+                        squared_error += diff * diff;
+                    }
+                }
+            }
+        }
+    }
+    double mse = squared_error / ((double)width * height * channel_count);
+    return (mse > 0) ? 10.0 * log10(255.0 * 255.0 / mse) : 99.0;
+}
+
+void bake_downsample(u8* src, u32 src_width, u32 src_height, u8* dst) {
+    // 2x2 box filter, odd edges reuse their last row/column
+    u32 dst_width = (src_width > 1) ? src_width / 2 : 1;
+    u32 dst_height = (src_height > 1) ? src_height / 2 : 1;
+    for (u32 y = 0; y < dst_height; y++) {
+        u32 y0 = y * 2;
+        u32 y1 = (y0 + 1 < src_height) ? y0 + 1 : y0;
+        for (u32 x = 0; x < dst_width; x++) {
+            u32 x0 = x * 2;
+            u32 x1 = (x0 + 1 < src_width) ? x0 + 1 : x0;
+            for (u32 c = 0; c < 4; c++) {
+                u32 sum = src[((u64)y0 * src_width + x0) * 4 + c] + src[((u64)y0 * src_width + x1) * 4 + c]
+                    + src[((u64)y1 * src_width + x0) * 4 + c] + src[((u64)y1 * src_width + x1) * 4 + c];
+                dst[((u64)y * dst_width + x) * 4 + c] = (u8)((sum + 2) / 4);
+            }
+        }
+    }
+}
+
+bool bake_texture(char* source_filename) {
+    texbake_header_t header = { 0 };
+    header.magic = TEXBAKE_MAGIC;
+    header.version = TEXBAKE_VERSION;
+    if (!get_file_info(source_filename, &header.source_size, &header.source_mtime)) return false;
+
+    // Same orientation as the runtime decode
+    filemap_t source_file = read_entire_file(source_filename);
+    int img_width, img_height, img_channel_count;
+    stbi_set_flip_vertically_on_load(true);
+    u8* image = stbi_load_from_memory(source_file.data, (int)source_file.size, &img_width, &img_height, &img_channel_count, 4);
+    unmap_file(&source_file);
+    if (!image) {
+        printf("problem with texture file: %s\n", source_filename);
+        return false;
+    }
+    header.width = (u32)img_width;
+    header.height = (u32)img_height;
+
+    bool has_alpha = false;
+    for (u64 i = 0; i < (u64)header.width * header.height; i++) {
+        if (image[i * 4 + 3] != 255) {
+            has_alpha = true;
+            break;
+        }
+    }
+    header.gl_format = has_alpha ? GL_COMPRESSED_RGBA_S3TC_DXT5_EXT : GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+
+    // Compress every level, downsampling from the previous uncompressed one
+    arena_t* scratch = get_scratch_arena(0);
+    u64 scratch_mark = arena_mark(scratch);
+    texbake_mip_t mips[TEXBAKE_MAX_MIPS] = { 0 };
+    u8* mip_blocks[TEXBAKE_MAX_MIPS];
+    u64 offset = sizeof(texbake_header_t);
+    u32 width = header.width, height = header.height;
+    u8* level = image;
+    double psnr = 0;
+    while (true) {
+        assert(header.mip_count < TEXBAKE_MAX_MIPS);
+        texbake_mip_t* p_mip = &mips[header.mip_count];
+        p_mip->width = width;
+        p_mip->height = height;
+        p_mip->size = (u32)bake_compressed_size(width, height, has_alpha);
+        mip_blocks[header.mip_count] = arena_push(scratch, p_mip->size);
+        bake_compress(level, width, height, has_alpha, mip_blocks[header.mip_count]);
+        if (header.mip_count == 0) psnr = bake_psnr(level, width, height, has_alpha, mip_blocks[0]);
+        header.mip_count++;
+        if (width == 1 && height == 1) break;
+
+        u8* next_level = arena_push(scratch, (u64)width * height * 4); // Generous, a quarter would do
+        bake_downsample(level, width, height, next_level);
+        level = next_level;
+        width = (width > 1) ? width / 2 : 1;
+        height = (height > 1) ? height / 2 : 1;
+    }
+    stbi_image_free(image);
+
+    offset += header.mip_count * sizeof(texbake_mip_t);
+    for (u32 i = 0; i < header.mip_count; i++) {
+        mips[i].offset = offset;
+        offset += mips[i].size;
+    }
+
+    char baked_filename[MAX_PATH];
+    get_texture_bake_filename(source_filename, baked_filename, MAX_PATH);
+    FILE* f = fopen(baked_filename, "wb");
+    if (f == NULL) {
+        printf("can't write baked texture: %s\n", baked_filename);
+        arena_pop_to(scratch, scratch_mark);
+        return false;
+    }
+    fwrite(&header, sizeof(header), 1, f);
+    fwrite(mips, sizeof(texbake_mip_t), header.mip_count, f);
+    for (u32 i = 0; i < header.mip_count; i++) {
+        fwrite(mip_blocks[i], 1, mips[i].size, f);
+    }
+    fclose(f);
+    arena_pop_to(scratch, scratch_mark);
+
+    u64 raw_size = (u64)header.width * header.height * 4 * 4 / 3; // What the runtime would have with glGenerateMipmap
+    u64 baked_size = offset - mips[0].offset;
+    printf("  %s: %ux%u %s, %u mips, %.1f KB -> %.1f KB, PSNR %.2f dB\n", source_filename, header.width, header.height,
+            has_alpha ? "BC3" : "BC1", header.mip_count, raw_size / 1024.0, baked_size / 1024.0, psnr);
+    return true;
+}
+
+void bake_textures(char* directory) {
+    char pattern[MAX_PATH];
+    append_prefix("/*.png", directory, MAX_PATH, pattern);
+    WIN32_FIND_DATAA find_data;
+    HANDLE find_handle = FindFirstFileA(pattern, &find_data);
+    if (find_handle == INVALID_HANDLE_VALUE) {
+        printf("no textures to bake in %s\n", directory);
+        return;
+    }
+
+    u32 baked_count = 0;
+    printf("baking %s\n", directory);
+    do {
+        char source_filename[MAX_PATH];
+        snprintf(source_filename, MAX_PATH, "%s/%s", directory, find_data.cFileName);
+        if (bake_texture(source_filename)) baked_count++;
+    } while (FindNextFileA(find_handle, &find_data));
+    FindClose(find_handle);
+    printf("baked %u textures\n", baked_count);
+}
@@ -0,0 +1,475 @@
+// Texture registry. Textures are keyed by their normalized path, compared without
+// case like the pack does, so each image is decoded and uploaded once no matter
+// how many meshes use it. Handles are refcounted, the GL texture goes away when
+// the last user releases it
+//
+// Decoding happens on a pool of worker threads, or in texture_cache_poll() if
+// none of them could start. An acquired texture is a 1x1
+// placeholder until the main thread picks up the decoded pixels in
+// texture_cache_poll() and uploads them into the same handle. Textures baked
+// with --bake-textures skip the decoding, their blocks are uploaded as they are
+
+DWORD WINAPI texture_decode_thread(LPVOID param);
+
+void texture_free_source(texture_t* p_texture) {
+    if (p_texture->pixels) stbi_image_free(p_texture->pixels);
+    p_texture->pixels = NULL;
+    unmap_file(&(p_texture->baked_file));
+}
+
+void texture_cache_init(texturecache_t* cache, bool pack_arrays) {
+    cache->pack_arrays = pack_arrays;
+
+    // Leave a core for the main thread
+    SYSTEM_INFO system_info;
+    GetSystemInfo(&system_info);
+    u32 worker_count = (system_info.dwNumberOfProcessors > 1) ? system_info.dwNumberOfProcessors - 1 : 1;
+    if (worker_count > TEXTURE_DECODE_MAX_THREADS) worker_count = TEXTURE_DECODE_MAX_THREADS;
+
+    stbi_set_flip_vertically_on_load(true); // Global in stb_image, so it's set before the workers start
+    cache->job_semaphore = CreateSemaphoreA(NULL, 0, TEXTURE_CACHE_MAX + TEXTURE_DECODE_MAX_THREADS, NULL);
+    assert(cache->job_semaphore);
+    // Only the workers that started are counted. Without any, texture_cache_poll decodes on the main thread
+    cache->worker_count = 0;
+    for (u32 i = 0; i < worker_count; i++) {
+        HANDLE thread = CreateThread(NULL, 0, texture_decode_thread, cache, 0, NULL);
+        if (thread != NULL) cache->worker_threads[cache->worker_count++] = thread;
+    }
+    if (cache->worker_count == 0) printf("no texture decode threads, decoding on the main thread\n");
+
+    glGenBuffers(1, &(cache->upload_pbo));
+}
+
+void texture_cache_destroy(texturecache_t* cache) {
+    cache->quitting = 1;
+    if (cache->worker_count > 0) {
+        ReleaseSemaphore(cache->job_semaphore, cache->worker_count, NULL);
+        WaitForMultipleObjects(cache->worker_count, cache->worker_threads, TRUE, INFINITE);
+    }
+    for (u32 i = 0; i < cache->worker_count; i++) {
+        CloseHandle(cache->worker_threads[i]);
+    }
+    CloseHandle(cache->job_semaphore);
+
+    // Whatever got decoded but never uploaded
+    for (u32 i = 0; i < TEXTURE_CACHE_MAX; i++) {
+        texture_free_source(&cache->entries[i]);
+    }
+    glDeleteBuffers(1, &(cache->upload_pbo));
+}
+
+void get_texture_bake_filename(char* source_filename, char* result, u64 max_len) {
+    // "textures/x.png" -> "textures/x.p7tex"
+    strcpy_s(result, max_len, source_filename);
+    char* extension = strrchr(result, '.');
+    if (extension != NULL) *extension = 0;
+    strcat_s(result, max_len, ".p7tex");
+}
+
+bool texture_map_baked(texture_t* p_texture) {
+    // Uses the .p7tex next to the source if it was baked from the current version of it
+    char baked_filename[MAX_PATH];
+    get_texture_bake_filename(p_texture->path, baked_filename, MAX_PATH);
+    filemap_t baked_file = map_entire_file(baked_filename, true);
+    if (baked_file.data == NULL) return false;
+
+    texbake_header_t* p_header = (texbake_header_t*)baked_file.data;
+    u64 source_size, source_mtime;
+    bool valid = baked_file.size >= sizeof(texbake_header_t)
+        && p_header->magic == TEXBAKE_MAGIC
+        && p_header->version == TEXBAKE_VERSION
+        && get_file_info(p_texture->path, &source_size, &source_mtime)
+        && p_header->source_size == source_size
+        && p_header->source_mtime == source_mtime;
+    if (!valid) {
+        printf("baked texture is stale, run with --bake-textures: %s\n", baked_filename);
+        unmap_file(&baked_file);
+        return false;
+    }
+
+    // The blocks are staged straight from the file, every mip has to be inside it.
+    // Anything off and the source image is decoded instead
+    valid = (p_header->gl_format == GL_COMPRESSED_RGB_S3TC_DXT1_EXT || p_header->gl_format == GL_COMPRESSED_RGBA_S3TC_DXT5_EXT)
+        && p_header->mip_count >= 1 && p_header->mip_count <= TEXBAKE_MAX_MIPS
+        && baked_file.size >= sizeof(texbake_header_t) + p_header->mip_count * sizeof(texbake_mip_t);
+    texbake_mip_t* mips = (texbake_mip_t*)(baked_file.data + sizeof(texbake_header_t));
+    for (u32 i = 0; valid && i < p_header->mip_count; i++) {
+        valid = mips[i].offset >= mips[0].offset
+            && mips[i].offset <= baked_file.size
+            && mips[i].size <= baked_file.size - mips[i].offset
+            && mips[i].width == ((p_header->width >> i) ? (p_header->width >> i) : 1)
+            && mips[i].height == ((p_header->height >> i) ? (p_header->height >> i) : 1);
+    }
+    if (!valid) {
+        printf("baked texture is corrupt, decoding the source: %s\n", baked_filename);
+        unmap_file(&baked_file);
+        return false;
+    }
+
+    p_texture->baked_file = baked_file;
+    p_texture->width = p_header->width;
+    p_texture->height = p_header->height;
+    p_texture->internal_format = p_header->gl_format;
+    if (p_texture->flags & TEXTURE_FLAG_SRGB) {
+        // Same blocks, the sampler just decodes them differently
+        p_texture->internal_format = (p_header->gl_format == GL_COMPRESSED_RGBA_S3TC_DXT5_EXT)
+            ? GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT : GL_COMPRESSED_SRGB_S3TC_DXT1_EXT;
+    }
+    p_texture->pixel_format = 0;
+    p_texture->mip_count = p_header->mip_count;
+    return true;
+}
+
+void texture_choose_format(texture_t* p_texture, u32 channel_count) {
+    // Whatever the image has, instead of always expanding to RGBA
+    static const u32 pixel_formats[5] = { 0, GL_RED, GL_RG, GL_RGB, GL_RGBA };
+    static const u32 internal_formats[5] = { 0, GL_R8, GL_RG8, GL_RGB8, GL_RGBA8 };
+    assert(channel_count >= 1 && channel_count <= 4);
+    p_texture->pixel_format = pixel_formats[channel_count];
+    p_texture->internal_format = internal_formats[channel_count];
+    if (p_texture->flags & TEXTURE_FLAG_SRGB) {
+        if (channel_count == 3) p_texture->internal_format = GL_SRGB8;
+        if (channel_count == 4) p_texture->internal_format = GL_SRGB8_ALPHA8;
+    }
+}
+
+void texture_decode(texture_t* p_texture) {
+    // Runs on a worker, touches nothing but the texture itself.
+    // A baked texture only needs mapping, otherwise the PNG is decoded with its own channel count.
+    // "pixels" stays NULL if the file can't be read
+    double decode_start_time = glfwGetTime();
+    if (texture_map_baked(p_texture)) {
+        p_texture->decode_time = glfwGetTime() - decode_start_time;
+        return;
+    }
+
+    filemap_t image_file = map_entire_file(p_texture->path, true);
+    int img_width = 0, img_height = 0, img_channel_count = 4;
+    if (image_file.data != NULL) {
+        p_texture->pixels = stbi_load_from_memory(image_file.data, (int)image_file.size, &img_width, &img_height, &img_channel_count, 0);
+    }
+    unmap_file(&image_file);
+
+    p_texture->decode_time = glfwGetTime() - decode_start_time;
+    p_texture->width = (u32)img_width;
+    p_texture->height = (u32)img_height;
+    texture_choose_format(p_texture, (u32)img_channel_count);
+    u32 largest_side = (p_texture->width > p_texture->height) ? p_texture->width : p_texture->height;
+    p_texture->mip_count = 1;
+    while ((1u << p_texture->mip_count) <= largest_side) p_texture->mip_count++; // Full chain, down to 1x1
+}
+
+void texture_decode_next_job(texturecache_t* cache) {
+    LONG i_job = InterlockedIncrement(&cache->job_pop_count) - 1;
+    texture_t* p_texture = &cache->entries[cache->job_queue[(u32)i_job % TEXTURE_CACHE_MAX]];
+    texture_decode(p_texture);
+    InterlockedExchange(&p_texture->state, TEXTURE_STATE_DECODED);
+}
+
+DWORD WINAPI texture_decode_thread(LPVOID param) {
+    texturecache_t* cache = param;
+    while (true) {
+        WaitForSingleObject(cache->job_semaphore, INFINITE);
+        if (cache->quitting) break;
+        texture_decode_next_job(cache);
+    }
+    return 0;
+}
+
+texture_t* texture_find(texturecache_t* cache, char* resolved_path, u64 path_hash, u32 flags) {
+    for (u32 i = 0; i < TEXTURE_CACHE_MAX; i++) {
+        texture_t* p_texture = &cache->entries[i];
+        if (p_texture->ref_count > 0 && p_texture->path_hash == path_hash && p_texture->flags == flags && _stricmp(p_texture->path, resolved_path) == 0) {
+            return p_texture;
+        }
+    }
+    return NULL;
+}
+
+void texture_set_sampling(void) {
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+}
+
+void texture_create_placeholder(texture_t* p_texture) {
+    // Everything is an array texture, this one has a single 1x1 layer
+    u8 placeholder_texel[4] = { 128, 128, 128, 255 };
+    glGenTextures(1, &(p_texture->handle));
+    gl_state_bind_texture(0, GL_TEXTURE_2D_ARRAY, p_texture->handle);
+    texture_set_sampling();
+    glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_RGBA8, 1, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, placeholder_texel);
+    p_texture->layer = 0;
+}
+
+void* texture_stage(texturecache_t* cache, u8* data, u64 size) {
+    // Copies into the pixel buffer and leaves it bound, so glTexImage2D returns without reading client memory.
+    // The buffer is orphaned every time, we never wait for the driver to finish with the previous upload
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, cache->upload_pbo);
+    glBufferData(GL_PIXEL_UNPACK_BUFFER, size, NULL, GL_STREAM_DRAW);
+    void* p_staging = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, size, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+    assert(p_staging);
+    memcpy(p_staging, data, size);
+    glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+    return (void*)0; // Offsets are into the PBO from here on
+}
+
+u32 texture_channel_count(u32 pixel_format) {
+    switch (pixel_format) {
+        case GL_RED: return 1;
+        case GL_RG: return 2;
+        case GL_RGB: return 3;
+        default: return 4;
+    }
+}
+
+bool texture_is_compatible(texture_t* a, texture_t* b) {
+    // Can share an array
+    return a->width == b->width && a->height == b->height && a->internal_format == b->internal_format && a->mip_count == b->mip_count;
+}
+
+void texture_upload_array(texturecache_t* cache, texture_t** textures, u32 texture_count) {
+    // One array texture, one layer per texture. The textures need to be compatible.
+    // Their placeholders are replaced with the array
+    texture_t* p_first = textures[0];
+    for (u32 i = 0; i < texture_count; i++) {
+        assert(textures[i]->pixels || textures[i]->baked_file.data);
+        assert(texture_is_compatible(textures[i], p_first));
+    }
+
+    u32 array_handle;
+    glGenTextures(1, &array_handle);
+    gl_state_bind_texture(0, GL_TEXTURE_2D_ARRAY, array_handle);
+    texture_set_sampling();
+    glTexStorage3D(GL_TEXTURE_2D_ARRAY, p_first->mip_count, p_first->internal_format, p_first->width, p_first->height, texture_count);
+    if (p_first->pixel_format == GL_RED || p_first->pixel_format == GL_RG) {
+        // Sampled the way stb_image would have expanded them: grey, and grey plus alpha
+        GLint swizzle[4] = { GL_RED, GL_RED, GL_RED, (p_first->pixel_format == GL_RG) ? GL_GREEN : GL_ONE };
+        glTexParameteriv(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_SWIZZLE_RGBA, swizzle);
+    }
+
+    for (u32 i_layer = 0; i_layer < texture_count; i_layer++) {
+        texture_t* p_texture = textures[i_layer];
+        if (p_texture->baked_file.data) {
+            // Blocks for every mip are already there
+            texbake_mip_t* mips = (texbake_mip_t*)(p_texture->baked_file.data + sizeof(texbake_header_t));
+            u64 blocks_offset = mips[0].offset;
+            u64 blocks_size = p_texture->baked_file.size - blocks_offset;
+            u8* p_base = texture_stage(cache, p_texture->baked_file.data + blocks_offset, blocks_size);
+            for (u32 i = 0; i < p_texture->mip_count; i++) {
+                glCompressedTexSubImage3D(GL_TEXTURE_2D_ARRAY, i, 0, 0, i_layer, mips[i].width, mips[i].height, 1,
+                        p_texture->internal_format, mips[i].size, p_base + (mips[i].offset - blocks_offset));
+            }
+            p_texture->vram_size = blocks_size;
+        }
+        else {
+            // Rows are tightly packed, GL assumes 4-byte aligned rows by default
+            u64 row_size = (u64)p_texture->width * texture_channel_count(p_texture->pixel_format);
+            u64 image_size = row_size * p_texture->height;
+            u8* p_base = texture_stage(cache, p_texture->pixels, image_size);
+            glPixelStorei(GL_UNPACK_ALIGNMENT, (row_size % 4 == 0) ? 4 : (row_size % 2 == 0) ? 2 : 1);
+            glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, i_layer, p_texture->width, p_texture->height, 1, p_texture->pixel_format, GL_UNSIGNED_BYTE, p_base);
+            glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+            p_texture->vram_size = image_size * 4 / 3; // The mip chain is about a third of the base level
+        }
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+        gl_state_delete_texture(&(p_texture->handle));
+        p_texture->handle = array_handle;
+        p_texture->layer = i_layer;
+        p_texture->state = TEXTURE_STATE_READY;
+        texture_free_source(p_texture);
+        cache->pending_count--;
+    }
+    if (p_first->pixel_format) glGenerateMipmap(GL_TEXTURE_2D_ARRAY); // All layers at once
+}
+
+void texture_cache_poll(texturecache_t* cache) {
+    // Once per frame. Uploads some of the textures the workers have finished, each into its own array.
+    // When packing, waits for every queued texture instead, and uploads compatible ones into shared arrays,
+    // a few arrays per frame
+    if (cache->worker_count == 0) {
+        // No workers, the jobs are decoded here. All of them when packing, it waits for every one anyway
+        u32 decode_count = 0;
+        while ((u32)cache->job_pop_count < cache->job_push_count && (cache->pack_arrays || decode_count < TEXTURE_UPLOADS_PER_FRAME)) {
+            texture_decode_next_job(cache);
+            decode_count++;
+        }
+    }
+
+    texture_t* decoded[TEXTURE_CACHE_MAX];
+    u32 decoded_count = 0;
+    for (u32 i = 0; i < TEXTURE_CACHE_MAX; i++) {
+        texture_t* p_texture = &cache->entries[i];
+        if (p_texture->state == TEXTURE_STATE_QUEUED && cache->pack_arrays) return;
+        if (p_texture->state != TEXTURE_STATE_DECODED) continue;
+
+        if (p_texture->ref_count > 0 && !p_texture->pixels && !p_texture->baked_file.data) {
+            // Nothing to upload, meshes using it keep drawing with the placeholder
+            printf("problem with texture file: %s\n", p_texture->path);
+            p_texture->state = TEXTURE_STATE_FAILED;
+            cache->pending_count--;
+        }
+        else if (p_texture->ref_count > 0) {
+            decoded[decoded_count++] = p_texture;
+        }
+        else {
+            // Released while it was being decoded
+            texture_free_source(p_texture);
+            p_texture->state = TEXTURE_STATE_EMPTY;
+            cache->pending_count--;
+        }
+    }
+
+    if (!cache->pack_arrays) {
+        for (u32 i = 0; i < decoded_count && i < TEXTURE_UPLOADS_PER_FRAME; i++) {
+            texture_upload_array(cache, &decoded[i], 1);
+        }
+        return;
+    }
+
+    // Group by size and format, the grouped ones are taken out of the list. Same budget
+    // as above, but an array's layers go in together so one group can go over it.
+    // Whatever is left stays decoded until the next poll
+    u32 upload_count = 0;
+    while (decoded_count > 0 && upload_count < TEXTURE_UPLOADS_PER_FRAME) {
+        texture_t* group[TEXTURE_CACHE_MAX];
+        u32 group_count = 0;
+        u32 remaining_count = 0;
+        texture_t* p_key = decoded[0];
+        for (u32 i = 0; i < decoded_count; i++) {
+            if (texture_is_compatible(decoded[i], p_key)) group[group_count++] = decoded[i];
+            else decoded[remaining_count++] = decoded[i];
+        }
+        texture_upload_array(cache, group, group_count);
+        upload_count += group_count;
+        decoded_count = remaining_count;
+    }
+}
+
+u32 texture_acquire(texturecache_t* cache, char* path, u32 flags) {
+    // "textures/a.png", "textures/../textures/a.png" and "Textures/A.png" are the same
+    // texture, paths compare like they do in the pack and on the file system
+    char resolved_path[MAX_PATH];
+    vfs_normalize_path(path, resolved_path, MAX_PATH);
+    u64 path_hash = vfs_hash_path(resolved_path);
+
+    texture_t* p_texture = texture_find(cache, resolved_path, path_hash, flags);
+    if (p_texture != NULL) {
+        p_texture->ref_count++;
+        p_texture->hit_count++;
+        cache->hit_count++;
+        return (u32)(p_texture - cache->entries);
+    }
+
+    // A released slot can still be in a worker's hands, those are skipped
+    for (u32 i = 0; i < TEXTURE_CACHE_MAX; i++) {
+        if (cache->entries[i].state == TEXTURE_STATE_EMPTY) {
+            p_texture = &cache->entries[i];
+            break;
+        }
+    }
+    if (p_texture == NULL) {
+        printf("texture cache is full, can't load: %s\n", path);
+        assert(false);
+    }
+
+    memset(p_texture, 0, sizeof(texture_t));
+    strcpy_s(p_texture->path, MAX_PATH, resolved_path);
+    p_texture->path_hash = path_hash;
+    p_texture->flags = flags;
+    p_texture->ref_count = 1;
+    texture_create_placeholder(p_texture);
+    cache->texture_count++;
+
+    p_texture->state = TEXTURE_STATE_QUEUED;
+    u32 texture_id = (u32)(p_texture - cache->entries);
+    cache->job_queue[cache->job_push_count % TEXTURE_CACHE_MAX] = texture_id;
+    cache->job_push_count++;
+    cache->pending_count++;
+    if (cache->worker_count > 0) ReleaseSemaphore(cache->job_semaphore, 1, NULL);
+
+    return texture_id;
+}
+
+void texture_release(texturecache_t* cache, u32 texture_id) {
+    assert(texture_id < TEXTURE_CACHE_MAX);
+    texture_t* p_texture = &cache->entries[texture_id];
+    assert(p_texture->ref_count > 0);
+    p_texture->ref_count--;
+    if (p_texture->ref_count > 0) return;
+    cache->texture_count--;
+
+    // A queued one is freed by texture_cache_poll when the worker is done with it
+    if (p_texture->state == TEXTURE_STATE_READY || p_texture->state == TEXTURE_STATE_FAILED) p_texture->state = TEXTURE_STATE_EMPTY;
+
+    // The array goes away with its last layer
+    for (u32 i = 0; i < TEXTURE_CACHE_MAX; i++) {
+        if (cache->entries[i].ref_count > 0 && cache->entries[i].handle == p_texture->handle) return;
+    }
+    gl_state_delete_texture(&(p_texture->handle));
+}
+
+char* texture_format_name(u32 internal_format) {
+    switch (internal_format) {
+        case GL_R8: return "R8";
+        case GL_RG8: return "RG8";
+        case GL_RGB8: return "RGB8";
+        case GL_RGBA8: return "RGBA8";
+        case GL_SRGB8: return "SRGB8";
+        case GL_SRGB8_ALPHA8: return "SRGB8_ALPHA8";
+        case GL_COMPRESSED_RGB_S3TC_DXT1_EXT: return "BC1";
+        case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT: return "BC3";
+        case GL_COMPRESSED_SRGB_S3TC_DXT1_EXT: return "BC1_SRGB";
+        case GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT: return "BC3_SRGB";
+        default: return "?";
+    }
+}
+
+void texture_print_memory_report(texturecache_t* cache) {
+    // Against what uploading everything as RGBA8 with mips would take
+    u64 total_size = 0, total_rgba_size = 0;
+    printf("texture memory:\n");
+    for (u32 i = 0; i < TEXTURE_CACHE_MAX; i++) {
+        texture_t* p_texture = &cache->entries[i];
+        if (p_texture->ref_count == 0 || p_texture->state != TEXTURE_STATE_READY) continue;
+        u64 rgba_size = (u64)p_texture->width * p_texture->height * 4 * 4 / 3;
+        char* file_name = strrchr(p_texture->path, '\\');
+        if (file_name == NULL) file_name = strrchr(p_texture->path, '/');
+        file_name = (file_name != NULL) ? file_name + 1 : p_texture->path;
+        printf("  %s: %ux%u %s, %.1f KB, %.1f KB saved\n", file_name, p_texture->width, p_texture->height,
+                texture_format_name(p_texture->internal_format), p_texture->vram_size / 1024.0, ((double)rgba_size - (double)p_texture->vram_size) / 1024.0);
+        total_size += p_texture->vram_size;
+        total_rgba_size += rgba_size;
+    }
+    printf("  total %.2f MB, %.2f MB as RGBA8\n", (double)total_size / (1024.0 * 1024.0), (double)total_rgba_size / (1024.0 * 1024.0));
+}
+
+void texture_print_stats(texturecache_t* cache) {
+    double decode_time = 0;
+    double decode_time_saved = 0;
+    u64 vram_size = 0;
+    u64 vram_saved = 0;
+    u32 baked_count = 0;
+    u32 array_count = 0;
+    for (u32 i = 0; i < TEXTURE_CACHE_MAX; i++) {
+        texture_t* p_texture = &cache->entries[i];
+        if (p_texture->ref_count == 0) continue;
+        bool first_layer = true;
+        for (u32 j = 0; j < i; j++) {
+            if (cache->entries[j].ref_count > 0 && cache->entries[j].handle == p_texture->handle) first_layer = false;
+        }
+        if (first_layer) array_count++;
+        decode_time += p_texture->decode_time;
+        vram_size += p_texture->vram_size;
+        if (!p_texture->pixel_format) baked_count++;
+        decode_time_saved += p_texture->hit_count * p_texture->decode_time;
+        vram_saved += p_texture->hit_count * p_texture->vram_size;
+    }
+    printf("texture cache: %u textures (%u baked) in %u arrays, %.2f MB of VRAM, %.2f ms of decoding on %u workers\n", cache->texture_count, baked_count,
+            array_count, (double)vram_size / (1024.0 * 1024.0), decode_time * 1000.0, cache->worker_count);
+    printf("  %u hits, %.2f ms of decoding saved, %.2f MB of VRAM not duplicated\n",
+            cache->hit_count, decode_time_saved * 1000.0, (double)vram_saved / (1024.0 * 1024.0));
+    texture_print_memory_report(cache);
+}
@@ -0,0 +1,250 @@
+// Asset pack lookup. When a pack is mounted, map_entire_file hands out views
+// into the pack's single mapping instead of opening files. The pack is then
+// the only source, a file that isn't in it is missing, so startup doesn't
+// touch the file system after the mount. Without a pack, loose files are used.
+// Paths are looked up normalized and case-insensitively, "./Textures\a.png"
+// finds "textures/a.png". Compressed entries (see lz.c) are decompressed into
+// their own allocation when mapped, large ones across several threads
+
+filemap_t map_entire_file(char* file_name, bool sequential);
+void unmap_file(filemap_t* p_map);
+
+static vfs_t vfs;
+
+void vfs_normalize_path(char* path, char* result, u64 max_len) {
+    // Backslashes become slashes, "." segments are dropped and ".." pops the previous one
+    u64 len = 0;
+    char* c = path;
+    while (*c) {
+        char* segment = c;
+        while (*c && *c != '/' && *c != '\\') c++;
+        u64 segment_len = (u64)(c - segment);
+        if (*c) c++;
+
+        if (segment_len == 0 || (segment_len == 1 && segment[0] == '.')) continue;
+        if (segment_len == 2 && segment[0] == '.' && segment[1] == '.' && len > 0) {
+            while (len > 0 && result[len - 1] != '/') len--;
+            if (len > 0) len--; // The slash
+            continue;
+        }
+
+        if (len > 0 && len + 1 < max_len) result[len++] = '/';
+        for (u64 i = 0; i < segment_len && len + 1 < max_len; i++) {
+            result[len++] = segment[i];
+        }
+    }
+    result[len] = 0;
+}
+
+u64 vfs_hash_path(char* normalized_path) {
+    // FNV-1a over the lower-cased path
+    u64 hash = 0xCBF29CE484222325ull;
+    for (char* c = normalized_path; *c; c++) {
+        char lower = (*c >= 'A' && *c <= 'Z') ? *c - 'A' + 'a' : *c;
+        hash = (hash ^ (u8)lower) * 0x100000001B3ull;
+    }
+    return hash;
+}
+
+bool vfs_is_mounted(void) {
+    return vfs.p_header != NULL;
+}
+
+packentry_t* vfs_find(char* file_name) {
+    // Linear probing over the bucket table. Safe to call from any thread
+    if (vfs.p_header == NULL) return NULL;
+
+    // A longer path can't be in the pack, the builder skips them. Cut short, it could match another file
+    char normalized_path[MAX_PATH];
+    vfs_normalize_path(file_name, normalized_path, MAX_PATH);
+    if (strlen(normalized_path) >= PACK_PATH_LEN) {
+        printf("path too long for the pack: %s\n", file_name);
+        InterlockedIncrement(&vfs.miss_count);
+        return NULL;
+    }
+    u64 path_hash = vfs_hash_path(normalized_path);
+    u32 bucket_mask = vfs.p_header->bucket_count - 1;
+    for (u32 i = (u32)path_hash & bucket_mask; vfs.buckets[i] != 0; i = (i + 1) & bucket_mask) {
+        packentry_t* p_entry = &vfs.entries[vfs.buckets[i] - 1];
+        if (p_entry->path_hash == path_hash && _stricmp(p_entry->path, normalized_path) == 0) {
+            InterlockedIncrement(&vfs.hit_count);
+            return p_entry;
+        }
+    }
+    InterlockedIncrement(&vfs.miss_count);
+    return NULL;
+}
+
+bool vfs_decompress_blocks(packentry_t* p_entry, u8* dst, u32 first_block, u32 block_count) {
+    // Blocks are back to back after the size table
+    u32* block_sizes = (u32*)(vfs.pack_file.data + p_entry->offset);
+    u8* block = (u8*)(block_sizes + p_entry->block_count);
+    for (u32 i = 0; i < first_block; i++) {
+        block += block_sizes[i] & ~PACK_BLOCK_STORED;
+    }
+
+    for (u32 i = first_block; i < first_block + block_count; i++) {
+        u32 stored_size = block_sizes[i] & ~PACK_BLOCK_STORED;
+        u64 block_offset = (u64)i * PACK_BLOCK_SIZE;
+        u64 block_size = p_entry->size - block_offset;
+        if (block_size > PACK_BLOCK_SIZE) block_size = PACK_BLOCK_SIZE;
+
+        if (block_sizes[i] & PACK_BLOCK_STORED) {
+            if (stored_size != block_size) return false;
+            memcpy(dst + block_offset, block, block_size);
+        } else if (lz_decompress(block, stored_size, dst + block_offset, block_size) != block_size) {
+            return false;
+        }
+        block += stored_size;
+    }
+    return true;
+}
+
+DWORD WINAPI vfs_decompress_thread(LPVOID param) {
+    packchunk_t* chunk = param;
+    chunk->failed = !vfs_decompress_blocks(chunk->p_entry, chunk->dst, chunk->first_block, chunk->block_count);
+    return 0;
+}
+
+bool vfs_decompress(packentry_t* p_entry, u8* dst) {
+    // Blocks are independent, so large entries are split into runs of blocks, one per thread
+    SYSTEM_INFO system_info;
+    GetSystemInfo(&system_info);
+    u32 thread_count = p_entry->block_count / PACK_DECOMPRESS_MIN_BLOCKS;
+    if (thread_count > system_info.dwNumberOfProcessors) thread_count = system_info.dwNumberOfProcessors;
+    if (thread_count > PACK_DECOMPRESS_MAX_THREADS) thread_count = PACK_DECOMPRESS_MAX_THREADS;
+    if (thread_count <= 1) return vfs_decompress_blocks(p_entry, dst, 0, p_entry->block_count);
+
+    packchunk_t chunks[PACK_DECOMPRESS_MAX_THREADS] = { 0 };
+    HANDLE threads[PACK_DECOMPRESS_MAX_THREADS];
+    u32 first_block = 0;
+    for (u32 i = 0; i < thread_count; i++) {
+        u32 block_count = p_entry->block_count / thread_count + (i < p_entry->block_count % thread_count ? 1 : 0);
+        chunks[i].p_entry = p_entry;
+        chunks[i].dst = dst;
+        chunks[i].first_block = first_block;
+        chunks[i].block_count = block_count;
+        first_block += block_count;
+    }
+    // The calling thread takes the first chunk, and any chunk it couldn't start a thread for
+    u32 started_count = 0;
+    for (u32 i = 1; i < thread_count; i++) {
+        HANDLE thread = CreateThread(NULL, 0, vfs_decompress_thread, &chunks[i], 0, NULL);
+        if (thread != NULL) threads[started_count++] = thread;
+        else vfs_decompress_thread(&chunks[i]);
+    }
+    vfs_decompress_thread(&chunks[0]);
+    if (started_count > 0) WaitForMultipleObjects(started_count, threads, TRUE, INFINITE);
+
+    bool succeeded = true;
+    for (u32 i = 0; i < started_count; i++) {
+        CloseHandle(threads[i]);
+    }
+    for (u32 i = 0; i < thread_count; i++) {
+        succeeded = succeeded && !chunks[i].failed;
+    }
+    return succeeded;
+}
+
+filemap_t vfs_map_entry(packentry_t* p_entry) {
+    // A view into the pack, or a decompressed copy that unmap_file frees.
+    // An entry that doesn't decompress comes back empty, like a missing file
+    filemap_t map = { 0 };
+    map.size = p_entry->size;
+    if (p_entry->block_count == 0) {
+        map.data = vfs.pack_file.data + p_entry->offset;
+        return map;
+    }
+
+    map.data = VirtualAlloc(NULL, p_entry->size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+    map.owns_data = true;
+    if (map.data == NULL || !vfs_decompress(p_entry, map.data)) {
+        printf("corrupt pack entry: %s\n", p_entry->path);
+        unmap_file(&map);
+    }
+    return map;
+}
+
+bool vfs_range_valid(u64 offset, u64 size, u64 file_size) {
+    return offset <= file_size && size <= file_size - offset;
+}
+
+bool vfs_entry_valid(packentry_t* p_entry, filemap_t* p_pack_file) {
+    // Lookups and maps trust the entry from then on
+    if (memchr(p_entry->path, 0, PACK_PATH_LEN) == NULL) return false;
+    if (!vfs_range_valid(p_entry->offset, p_entry->stored_size, p_pack_file->size)) return false;
+    if (p_entry->block_count == 0) return p_entry->size == p_entry->stored_size;
+
+    // Every block is full but the last, and they all fit in what's stored
+    u64 block_count = (p_entry->size + PACK_BLOCK_SIZE - 1) / PACK_BLOCK_SIZE;
+    if (p_entry->block_count != block_count) return false;
+    u64 table_size = (u64)p_entry->block_count * sizeof(u32);
+    if (table_size > p_entry->stored_size) return false;
+    u32* block_sizes = (u32*)(p_pack_file->data + p_entry->offset);
+    u64 blocks_size = 0;
+    for (u32 i = 0; i < p_entry->block_count; i++) {
+        blocks_size += block_sizes[i] & ~PACK_BLOCK_STORED;
+    }
+    return blocks_size <= p_entry->stored_size - table_size;
+}
+
+bool vfs_mount_view(filemap_t pack_file, char* pack_filename) {
+    // Takes ownership of the view, which can be empty if the pack couldn't be read.
+    // Nothing past the header is looked at before the header checks out
+    packheader_t* p_header = (packheader_t*)pack_file.data;
+    bool valid = pack_file.data != NULL
+        && pack_file.size >= sizeof(packheader_t)
+        && p_header->magic == PACK_MAGIC
+        && p_header->version == PACK_VERSION
+        && p_header->bucket_count != 0 && (p_header->bucket_count & (p_header->bucket_count - 1)) == 0
+        && p_header->entry_count < p_header->bucket_count // Probing stops at an empty bucket
+        && vfs_range_valid(p_header->toc_offset, (u64)p_header->entry_count * sizeof(packentry_t), pack_file.size)
+        && vfs_range_valid(p_header->bucket_offset, (u64)p_header->bucket_count * sizeof(u32), pack_file.size);
+    packentry_t* entries = valid ? (packentry_t*)(pack_file.data + p_header->toc_offset) : NULL;
+    u32* buckets = valid ? (u32*)(pack_file.data + p_header->bucket_offset) : NULL;
+    for (u32 i = 0; valid && i < p_header->entry_count; i++) {
+        valid = vfs_entry_valid(&entries[i], &pack_file);
+    }
+    for (u32 i = 0; valid && i < p_header->bucket_count; i++) {
+        valid = buckets[i] <= p_header->entry_count;
+    }
+    if (!valid) {
+        printf("not a valid pack, using loose files: %s\n", pack_filename);
+        unmap_file(&pack_file);
+        return false;
+    }
+
+    vfs.pack_file = pack_file;
+    vfs.entries = entries;
+    vfs.buckets = buckets;
+    vfs.p_header = p_header; // Lookups start here
+    printf("mounted %s: %u files, %.2f MB\n", pack_filename, p_header->entry_count, (double)pack_file.size / (1024.0 * 1024.0));
+    return true;
+}
+
+bool vfs_mount(char* pack_filename) {
+    // Looks in the working directory, then next to the exe
+    filemap_t pack_file = map_entire_file(pack_filename, true); // Prefetches the whole pack
+    if (pack_file.data == NULL) {
+        char exe_path[MAX_PATH];
+        DWORD exe_path_len = GetModuleFileNameA(NULL, exe_path, MAX_PATH);
+        char* exe_dir_end = strrchr(exe_path, '\\');
+        if (exe_path_len > 0 && exe_dir_end != NULL) {
+            exe_dir_end[1] = 0;
+            strcat_s(exe_path, MAX_PATH, pack_filename);
+            pack_file = map_entire_file(exe_path, true);
+        }
+    }
+    if (pack_file.data == NULL) return false;
+    return vfs_mount_view(pack_file, pack_filename);
+}
+
+void vfs_unmount(void) {
+    vfs.p_header = NULL;
+    unmap_file(&vfs.pack_file);
+}
+
+void vfs_print_stats(void) {
+    if (vfs.p_header == NULL) return;
+    printf("pack: %d files served, %d lookups for files that aren't in it\n", (i32)vfs.hit_count, (i32)vfs.miss_count);
+}